@@ -2,6 +2,33 @@
 #include <vector>
 #include <random>
 #include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
 
 /*
 You are given a locked container represented as a two-dimensional grid of boolean values (true = locked, false = unlocked).
@@ -100,146 +127,4325 @@ private:
 };
 void print(SecureBox& box)
 {
-    for (int i = 0; i < box.getState().size(); i++)
+    const auto state = box.getState();
+    for (size_t i = 0; i < state.size(); i++)
+    {
+        for (size_t j = 0; j < state[i].size(); j++)
+        {
+            std::cout << state[i][j] << " ";
+        }
+        std::cout << std::endl;
+    }
+}
+
+//================================================================================
+// Packed GF(2) helpers
+// Description: Box states and toggle sets are stored row-major, one bit per
+//              cell (cell p = i * x + j), packed into 64-bit words. All of the
+//              solvers below take and return this layout.
+//================================================================================
+using BitVector = std::vector<uint64_t>;
+
+inline size_t wordCount(size_t bits)
+{
+    return (bits + 63) / 64;
+}
+
+inline bool testBit(const BitVector& v, size_t i)
+{
+    return (v[i / 64] >> (i % 64)) & 1;
+}
+
+inline void flipBit(BitVector& v, size_t i)
+{
+    v[i / 64] ^= uint64_t(1) << (i % 64);
+}
+
+inline int popcount64(uint64_t w)
+{
+    return __builtin_popcountll(w);
+}
+
+inline int countTrailingZeros64(uint64_t w)
+{
+    return __builtin_ctzll(w);
+}
+
+//================================================================================
+// Hardware counters
+// Description: Optional perf_event counters (Linux only) read around the same
+//              phases that are traced. Each thread opens its own counters on
+//              first use, counting user-space events of that thread only, and
+//              accumulates per-phase deltas into a thread-local report, so a
+//              caller reads the report for a solve or a batch on the thread
+//              that ran it. Counters the host refuses (perf_event_paranoid,
+//              VMs without a PMU) are reported as unavailable.
+//================================================================================
+enum HardwareCounter
+{
+    Cycles,
+    Instructions,
+    LlcMisses,
+    DtlbMisses,
+    BranchMisses,
+    kHardwareCounters
+};
+
+const char* hardwareCounterName(int counter)
+{
+    static const char* const names[kHardwareCounters] = { "cycles", "instructions", "llc-misses", "dtlb-misses", "branch-misses" };
+    return names[counter];
+}
+
+struct CounterValues
+{
+    uint64_t value[kHardwareCounters] = {};
+    uint32_t availableMask = 0;
+};
+
+std::atomic<bool> countersEnabled{ false };
+
+//================================================================================
+// Class: PerfCounters
+// Description: One perf_event file descriptor per counter for the calling
+//              thread, opened independently so one unsupported event doesn't
+//              disable the rest.
+//================================================================================
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+#if defined(__linux__)
+        const uint64_t cacheMiss = (uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8) | (uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+        const uint32_t types[kHardwareCounters] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+        const uint64_t configs[kHardwareCounters] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                      PERF_COUNT_HW_CACHE_LL | cacheMiss, PERF_COUNT_HW_CACHE_DTLB | cacheMiss,
+                                                      PERF_COUNT_HW_BRANCH_MISSES };
+        for (int c = 0; c < kHardwareCounters; c++)
+        {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = types[c];
+            attr.config = configs[c];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[c] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#else
+        std::fill(fds, fds + kHardwareCounters, -1);
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#if defined(__linux__)
+        for (int fd : fds)
+            if (fd >= 0)
+                close(fd);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void read(CounterValues& values) const
+    {
+        values.availableMask = 0;
+        for (int c = 0; c < kHardwareCounters; c++)
+        {
+            values.value[c] = 0;
+#if defined(__linux__)
+            if (fds[c] >= 0 && ::read(fds[c], &values.value[c], sizeof(uint64_t)) == sizeof(uint64_t))
+                values.availableMask |= 1u << c;
+#endif
+        }
+    }
+
+private:
+    int fds[kHardwareCounters];
+};
+
+struct PhaseCounters
+{
+    uint64_t calls = 0;
+    CounterValues totals;
+};
+
+using CounterReport = std::map<std::string, PhaseCounters>;
+
+CounterReport& threadCounterReport()
+{
+    thread_local CounterReport report;
+    return report;
+}
+
+void readThreadCounters(CounterValues& values)
+{
+    thread_local PerfCounters counters;
+    counters.read(values);
+}
+
+//================================================================================
+// Function: takeCounterReport
+// Description: Returns and clears the calling thread's per-phase counters.
+//              Phases nest (a backend span contains its matrix build), so
+//              totals are inclusive.
+//================================================================================
+CounterReport takeCounterReport()
+{
+    CounterReport report;
+    report.swap(threadCounterReport());
+    return report;
+}
+
+//================================================================================
+// Function: printCounterReport
+// Description: One line per phase: calls, then each counter or "n/a".
+//================================================================================
+void printCounterReport(std::ostream& out, const CounterReport& report)
+{
+    for (const auto& phase : report)
+    {
+        out << phase.first << ": calls=" << phase.second.calls;
+        for (int c = 0; c < kHardwareCounters; c++)
+        {
+            out << ' ' << hardwareCounterName(c) << '=';
+            if (phase.second.totals.availableMask >> c & 1)
+                out << phase.second.totals.value[c];
+            else
+                out << "n/a";
+        }
+        out << '\n';
+    }
+}
+
+//================================================================================
+// Tracing
+// Description: Optional span tracing of solver phases, exported as Chrome
+//              trace JSON (chrome://tracing, ui.perfetto.dev). Each thread
+//              appends to its own fixed-size buffer, publishing events with a
+//              release store of the event count, so recording takes no locks
+//              and a writer can export while solvers are running. Buffers are
+//              linked into a global list on a thread's first span and live
+//              for the rest of the process. Spans also feed the hardware
+//              counter report when counters are enabled. With both off a span
+//              costs two relaxed loads.
+//================================================================================
+struct TraceEvent
+{
+    const char* name;   // string literal
+    uint64_t startNs;
+    uint64_t durationNs;
+};
+
+struct TraceBuffer
+{
+    static constexpr size_t kCapacity = 1 << 14;
+
+    uint32_t tid = 0;
+    std::atomic<size_t> count{ 0 };
+    std::atomic<size_t> dropped{ 0 };
+    TraceBuffer* next = nullptr;
+    TraceEvent events[kCapacity];
+};
+
+std::atomic<bool> traceEnabled{ false };
+std::atomic<TraceBuffer*> traceBuffers{ nullptr };
+
+inline uint64_t traceNowNs()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+//================================================================================
+// Function: threadTraceBuffer
+// Description: The calling thread's buffer, pushed onto the global list with
+//              a CAS loop the first time it is needed.
+//================================================================================
+TraceBuffer& threadTraceBuffer()
+{
+    static std::atomic<uint32_t> nextTid{ 1 };
+    thread_local TraceBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        buffer = new TraceBuffer;
+        buffer->tid = nextTid.fetch_add(1, std::memory_order_relaxed);
+        buffer->next = traceBuffers.load(std::memory_order_relaxed);
+        while (!traceBuffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+    return *buffer;
+}
+
+//================================================================================
+// Class: TraceSpan
+// Description: Records [construction, destruction) as a span on the calling
+//              thread, or up to an earlier close(), and adds the counter
+//              deltas over the same interval to the thread's counter report.
+//              next() closes the current span and opens another with the same
+//              name, for phases that repeat inside a loop such as elimination
+//              panels.
+//================================================================================
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* spanName) : name(spanName) { open(); }
+
+    ~TraceSpan() { close(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void next()
+    {
+        close();
+        open();
+    }
+
+    void close()
+    {
+        if (counting)
+        {
+            counting = false;
+            CounterValues end;
+            readThreadCounters(end);
+            PhaseCounters& phase = threadCounterReport()[name];
+            phase.calls++;
+            const uint32_t available = startCounters.availableMask & end.availableMask;
+            phase.totals.availableMask |= available;
+            for (int c = 0; c < kHardwareCounters; c++)
+                if (available >> c & 1)
+                    phase.totals.value[c] += end.value[c] - startCounters.value[c];
+        }
+
+        if (!active)
+            return;
+        active = false;
+        const uint64_t end = traceNowNs();
+        TraceBuffer& buffer = threadTraceBuffer();
+        const size_t n = buffer.count.load(std::memory_order_relaxed);
+        if (n == TraceBuffer::kCapacity)
+        {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        buffer.events[n] = TraceEvent{ name, start, end - start };
+        buffer.count.store(n + 1, std::memory_order_release);
+    }
+
+private:
+    void open()
+    {
+        active = traceEnabled.load(std::memory_order_relaxed);
+        start = active ? traceNowNs() : 0;
+        counting = countersEnabled.load(std::memory_order_relaxed);
+        if (counting)
+            readThreadCounters(startCounters);
+    }
+
+    const char* name;
+    bool active = false;
+    bool counting = false;
+    uint64_t start = 0;
+    CounterValues startCounters;
+};
+
+//================================================================================
+// Function: writeChromeTrace
+// Description: Writes every recorded span as a complete ("X") event in Chrome
+//              trace JSON, one track per thread. Returns false if the file
+//              can't be written.
+//================================================================================
+bool writeChromeTrace(const std::string& path)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        return false;
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const char* separator = "\n";
+    char line[256];
+    for (const TraceBuffer* buffer = traceBuffers.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+    {
+        const size_t n = buffer->count.load(std::memory_order_acquire);
+        for (size_t e = 0; e < n; e++)
+        {
+            const TraceEvent& event = buffer->events[e];
+            std::snprintf(line, sizeof(line),
+                          "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                          separator, event.name, buffer->tid, event.startNs / 1000.0, event.durationNs / 1000.0);
+            out << line;
+            separator = ",\n";
+        }
+        if (const size_t dropped = buffer->dropped.load(std::memory_order_relaxed))
+        {
+            std::snprintf(line, sizeof(line),
+                          "%s{\"name\":\"dropped spans\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":0,\"args\":{\"dropped\":%zu}}",
+                          separator, buffer->tid, dropped);
+            out << line;
+            separator = ",\n";
+        }
+    }
+    out << "\n]}\n";
+    return bool(out);
+}
+
+//================================================================================
+// Function: readBits
+// Description: Copies bits [start, start + len) of v into out, starting at bit
+//              0. Used to lift one box row out of the packed state, whose rows
+//              are generally not word-aligned.
+//================================================================================
+void readBits(const BitVector& v, size_t start, size_t len, uint64_t* out)
+{
+    for (size_t k = 0; k < wordCount(len); k++)
+    {
+        const size_t w = (start + 64 * k) / 64, o = (start + 64 * k) % 64;
+        uint64_t val = v[w] >> o;
+        if (o && w + 1 < v.size())
+            val |= v[w + 1] << (64 - o);
+        if (len - 64 * k < 64)
+            val &= (uint64_t(1) << (len - 64 * k)) - 1;
+        out[k] = val;
+    }
+}
+
+//================================================================================
+// Function: xorBits
+// Description: XORs len bits from in (starting at bit 0) into v at bit start.
+//================================================================================
+void xorBits(BitVector& v, size_t start, size_t len, const uint64_t* in)
+{
+    for (size_t k = 0; k < wordCount(len); k++)
+    {
+        uint64_t val = in[k];
+        if (len - 64 * k < 64)
+            val &= (uint64_t(1) << (len - 64 * k)) - 1;
+        const size_t w = (start + 64 * k) / 64, o = (start + 64 * k) % 64;
+        v[w] ^= val << o;
+        if (o && w + 1 < v.size())
+            v[w + 1] ^= val >> (64 - o);
+    }
+}
+
+//================================================================================
+// Function: packState
+// Description: Converts the nested state returned by SecureBox::getState into
+//              the packed row-major layout.
+//================================================================================
+BitVector packState(const std::vector<std::vector<bool>>& state, uint32_t y, uint32_t x)
+{
+    BitVector packed(wordCount(size_t(y) * x), 0);
+    for (uint32_t i = 0; i < y; i++)
+        for (uint32_t j = 0; j < x; j++)
+            if (state[i][j])
+                flipBit(packed, size_t(i) * x + j);
+    return packed;
+}
+
+//================================================================================
+// Function: applyToggles
+// Description: Toggles every cell whose bit is set in the packed toggle set.
+//================================================================================
+void applyToggles(SecureBox& box, const BitVector& ans, uint32_t x)
+{
+    TraceSpan span("apply toggles");
+    for (size_t w = 0; w < ans.size(); w++)
+    {
+        for (uint64_t bits = ans[w]; bits; bits &= bits - 1)
+        {
+            size_t q = w * 64 + countTrailingZeros64(bits);
+            box.toggle(uint32_t(q / x), uint32_t(q % x));
+        }
+    }
+}
+
+//================================================================================
+// Function: transpose64
+// Description: In-place transpose of a 64x64 bit matrix (bit c of a[r] is
+//              element (r, c)). Six rounds of masked block swaps, halving the
+//              block size each round, instead of 4096 single-bit moves.
+//================================================================================
+void transpose64(uint64_t* a)
+{
+    uint64_t m = 0x00000000FFFFFFFFull;
+    for (int j = 32; j != 0; j >>= 1, m ^= m << j)
+    {
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j)
+        {
+            uint64_t t = ((a[k] >> j) ^ a[k + j]) & m;
+            a[k + j] ^= t;
+            a[k] ^= t << j;
+        }
+    }
+}
+
+//================================================================================
+// Function: transpose256
+// Description: In-place transpose of a 256x256 bit matrix stored as 256 rows of
+//              four words. Runs the transpose64 rounds on all four 64x64 tiles
+//              of a row band together (the inner lane loop vectorizes to one
+//              256-bit operation), then swaps the off-diagonal tiles.
+//================================================================================
+void transpose256(uint64_t (*a)[4])
+{
+    uint64_t m = 0x00000000FFFFFFFFull;
+    for (int j = 32; j != 0; j >>= 1, m ^= m << j)
+    {
+        for (int band = 0; band < 256; band += 64)
+        {
+            for (int k = band; k < band + 64; k = ((k | j) + 1) & ~j)
+            {
+                for (int l = 0; l < 4; l++)
+                {
+                    uint64_t t = ((a[k][l] >> j) ^ a[k + j][l]) & m;
+                    a[k + j][l] ^= t;
+                    a[k][l] ^= t << j;
+                }
+            }
+        }
+    }
+
+    for (int r = 0; r < 4; r++)
+        for (int c = r + 1; c < 4; c++)
+            for (int i = 0; i < 64; i++)
+                std::swap(a[r * 64 + i][c], a[c * 64 + i][r]);
+}
+
+//================================================================================
+// Class: BitMatrix
+// Description: Dense GF(2) matrix with each row packed into 64-bit words, so
+//              that row operations run a word (64 columns) at a time.
+//================================================================================
+class BitMatrix
+{
+public:
+    BitMatrix() = default;
+
+    BitMatrix(size_t rows, size_t cols)
+        : rowCount(rows), colCount(cols), stride(wordCount(cols)), bits(rows * stride, 0)
+    {
+    }
+
+    size_t rows() const { return rowCount; }
+    size_t cols() const { return colCount; }
+    size_t words() const { return stride; }
+
+    uint64_t* row(size_t r) { return bits.data() + r * stride; }
+    const uint64_t* row(size_t r) const { return bits.data() + r * stride; }
+
+    bool get(size_t r, size_t c) const
+    {
+        return (row(r)[c / 64] >> (c % 64)) & 1;
+    }
+
+    void flip(size_t r, size_t c)
+    {
+        row(r)[c / 64] ^= uint64_t(1) << (c % 64);
+    }
+
+    void set(size_t r, size_t c)
+    {
+        row(r)[c / 64] |= uint64_t(1) << (c % 64);
+    }
+
+    //================================================================================
+    // Method: xorRow
+    // Description: Row dst ^= row src, starting at word firstWord. Eliminations
+    //              pass the word holding the pivot column, since everything to
+    //              its left is already zero in both rows.
+    //================================================================================
+    void xorRow(size_t dst, size_t src, size_t firstWord = 0)
+    {
+        uint64_t* d = row(dst);
+        const uint64_t* s = row(src);
+        for (size_t w = firstWord; w < stride; w++)
+            d[w] ^= s[w];
+    }
+
+    void swapRows(size_t a, size_t b)
+    {
+        std::swap_ranges(row(a), row(a) + stride, row(b));
+    }
+
+    //================================================================================
+    // Method: transposed
+    // Description: Returns the transpose, built tile by tile on transpose256.
+    //              Used to switch between row-major and column-major access.
+    //================================================================================
+    BitMatrix transposed() const
+    {
+        BitMatrix out(colCount, rowCount);
+        uint64_t tile[256][4];
+        for (size_t r0 = 0; r0 < rowCount; r0 += 256)
+        {
+            for (size_t c0 = 0; c0 < colCount; c0 += 256)
+            {
+                for (size_t i = 0; i < 256; i++)
+                    for (size_t l = 0; l < 4; l++)
+                        tile[i][l] = (r0 + i < rowCount && c0 / 64 + l < stride) ? row(r0 + i)[c0 / 64 + l] : 0;
+
+                transpose256(tile);
+
+                for (size_t k = 0; k < 256 && c0 + k < colCount; k++)
+                    for (size_t l = 0; l < 4 && r0 / 64 + l < out.stride; l++)
+                        out.row(c0 + k)[r0 / 64 + l] = tile[k][l];
+            }
+        }
+        return out;
+    }
+
+    //================================================================================
+    // Method: multiply
+    // Description: Returns this * v for a packed column vector v.
+    //================================================================================
+    BitVector multiply(const BitVector& v) const
+    {
+        BitVector out(wordCount(rowCount), 0);
+        for (size_t r = 0; r < rowCount; r++)
+        {
+            const uint64_t* m = row(r);
+            uint64_t acc = 0;
+            for (size_t w = 0; w < stride; w++)
+                acc ^= m[w] & v[w];
+            if (popcount64(acc) & 1)
+                flipBit(out, r);
+        }
+        return out;
+    }
+
+private:
+    size_t rowCount = 0, colCount = 0, stride = 0;
+    std::vector<uint64_t> bits;
+};
+
+//================================================================================
+// Function: buildToggleSystem
+// Description: Builds the boxSize x boxSize system matrix of the toggle
+//              operator: entry (p, q) is 1 when toggling q flips p, i.e. when
+//              p and q share a row or a column.
+//================================================================================
+BitMatrix buildToggleSystem(uint32_t y, uint32_t x)
+{
+    TraceSpan span("build matrix");
+    const size_t boxSize = size_t(y) * x;
+    BitMatrix system(boxSize, boxSize);
+    for (uint32_t i = 0; i < y; i++)
+    {
+        for (uint32_t j = 0; j < x; j++)
+        {
+            size_t p = size_t(i) * x + j;
+            for (uint32_t a = 0; a < y; a++)
+                system.set(p, size_t(a) * x + j);
+            for (uint32_t b = 0; b < x; b++)
+                system.set(p, size_t(i) * x + b);
+        }
+    }
+    return system;
+}
+
+//================================================================================
+// Struct: SolveMap
+// Description: The cached inverse of the toggle system for one (y, x) shape.
+//              Solving is linear in the state, so for a fixed shape it reduces
+//              to two matrix-vector products:
+//                  ans    = solution * state
+//                  solvable iff checks * state == 0
+//              Free variables are fixed to 0, exactly as in openBox.
+//================================================================================
+struct SolveMap
+{
+    uint32_t y = 0, x = 0;
+    size_t rank = 0;
+    BitMatrix solution; // boxSize x boxSize
+    BitMatrix checks;   // (boxSize - rank) x boxSize, left null space of the system
+    BitMatrix kernel;   // (boxSize - rank) x boxSize, basis of the toggle sets that change nothing
+};
+
+//================================================================================
+// Function: buildSolveMap
+// Description: Runs Gauss-Jordan elimination on [A | I]. After elimination the
+//              right half holds the row transform E with E * A = RREF(A), so
+//              pivot rows of E give the solution and the remaining rows of E
+//              give the consistency checks. Each free column f of the left
+//              half gives a kernel vector: f itself plus the pivot columns
+//              whose reduced rows contain f.
+//================================================================================
+SolveMap buildSolveMap(uint32_t y, uint32_t x)
+{
+    const size_t boxSize = size_t(y) * x;
+    const BitMatrix system = buildToggleSystem(y, x);
+
+    BitMatrix augmented(boxSize, 2 * boxSize);
+    for (size_t r = 0; r < boxSize; r++)
+    {
+        std::copy(system.row(r), system.row(r) + system.words(), augmented.row(r));
+        augmented.set(r, boxSize + r);
+    }
+
+    size_t row = 0;
+    std::vector<int64_t> index(boxSize, -1);
+    for (size_t col = 0; col < boxSize && row < boxSize; col++)
+    {
+        size_t pivot = row;
+        while (pivot < boxSize && !augmented.get(pivot, col))
+            pivot++;
+        if (pivot == boxSize)
+            continue;
+
+        augmented.swapRows(row, pivot);
+        index[col] = int64_t(row);
+        for (size_t r = 0; r < boxSize; r++)
+            if (r != row && augmented.get(r, col))
+                augmented.xorRow(r, row, col / 64);
+        row++;
+    }
+
+    SolveMap map;
+    map.y = y;
+    map.x = x;
+    map.rank = row;
+    map.solution = BitMatrix(boxSize, boxSize);
+    map.checks = BitMatrix(boxSize - row, boxSize);
+
+    for (size_t col = 0; col < boxSize; col++)
+    {
+        if (index[col] == -1)
+            continue;
+        for (size_t c = 0; c < boxSize; c++)
+            if (augmented.get(size_t(index[col]), boxSize + c))
+                map.solution.set(col, c);
+    }
+    for (size_t r = row; r < boxSize; r++)
+        for (size_t c = 0; c < boxSize; c++)
+            if (augmented.get(r, boxSize + c))
+                map.checks.set(r - row, c);
+
+    map.kernel = BitMatrix(boxSize - row, boxSize);
+    size_t free = 0;
+    for (size_t f = 0; f < boxSize; f++)
+    {
+        if (index[f] != -1)
+            continue;
+        map.kernel.set(free, f);
+        for (size_t c = 0; c < boxSize; c++)
+            if (index[c] != -1 && augmented.get(size_t(index[c]), f))
+                map.kernel.set(free, c);
+        free++;
+    }
+
+    return map;
+}
+
+std::mutex solveMapsLock;
+std::map<std::pair<uint32_t, uint32_t>, SolveMap> solveMaps;
+
+//================================================================================
+// Function: cachedSolveMap
+// Description: Returns the solve map for (y, x), building it on first use.
+//================================================================================
+const SolveMap& cachedSolveMap(uint32_t y, uint32_t x)
+{
+    std::lock_guard<std::mutex> guard(solveMapsLock);
+    auto it = solveMaps.find({ y, x });
+    if (it == solveMaps.end())
+        it = solveMaps.emplace(std::make_pair(y, x), buildSolveMap(y, x)).first;
+    return it->second;
+}
+
+//================================================================================
+// Function: findSolveMap
+// Description: Returns the solve map for (y, x), or nullptr if it has not been
+//              built.
+//================================================================================
+const SolveMap* findSolveMap(uint32_t y, uint32_t x)
+{
+    std::lock_guard<std::mutex> guard(solveMapsLock);
+    auto it = solveMaps.find({ y, x });
+    return it == solveMaps.end() ? nullptr : &it->second;
+}
+
+//================================================================================
+// Class: XorProgram
+// Description: A straight-line XOR circuit computing a fixed GF(2) linear map.
+//              Signals 0..inputCount-1 are the input bits, every op appends one
+//              new signal (a ^ b), and each output names the signal holding its
+//              value (or kZero). The op list doubles as the interpreted bytecode.
+//
+//              For a solve map the outputs are the toggleCount toggle bits
+//              followed by the consistency checks.
+//================================================================================
+class XorProgram
+{
+public:
+    static constexpr uint32_t kZero = UINT32_MAX;
+
+    struct Op
+    {
+        uint32_t a, b;
+    };
+
+    //================================================================================
+    // Method: compile
+    // Description: Paar's greedy common-subexpression heuristic: repeatedly
+    //              pick the pair of signals shared by the most outputs, compute
+    //              it once and substitute it everywhere. Once no pair is shared
+    //              by two or more outputs, the remaining terms of each output are
+    //              chained directly.
+    //================================================================================
+    static XorProgram compile(const BitMatrix& map, size_t toggleCount)
+    {
+        const size_t outputs = map.rows();
+        const size_t outWords = wordCount(outputs);
+
+        XorProgram program;
+        program.inputCount = uint32_t(map.cols());
+        program.toggleCount = toggleCount;
+
+        // uses[s] is the set of outputs that still need signal s: column s of the map
+        const BitMatrix columns = map.transposed();
+        std::vector<BitVector> uses(map.cols());
+        for (size_t c = 0; c < map.cols(); c++)
+            uses[c].assign(columns.row(c), columns.row(c) + outWords);
+
+        std::vector<uint32_t> active;
+        for (;;)
+        {
+            active.clear();
+            for (uint32_t s = 0; s < uses.size(); s++)
+                if (std::any_of(uses[s].begin(), uses[s].end(), [](uint64_t w) { return w != 0; }))
+                    active.push_back(s);
+
+            int best = 1;
+            uint32_t bestA = 0, bestB = 0;
+            for (size_t i = 0; i < active.size(); i++)
+            {
+                const uint64_t* ua = uses[active[i]].data();
+                for (size_t k = i + 1; k < active.size(); k++)
+                {
+                    const uint64_t* ub = uses[active[k]].data();
+                    int shared = 0;
+                    for (size_t w = 0; w < outWords; w++)
+                        shared += popcount64(ua[w] & ub[w]);
+                    if (shared > best)
+                    {
+                        best = shared;
+                        bestA = active[i];
+                        bestB = active[k];
+                    }
+                }
+            }
+            if (best <= 1)
+                break;
+
+            BitVector common(outWords);
+            for (size_t w = 0; w < outWords; w++)
+            {
+                common[w] = uses[bestA][w] & uses[bestB][w];
+                uses[bestA][w] &= ~common[w];
+                uses[bestB][w] &= ~common[w];
+            }
+            program.ops.push_back({ bestA, bestB });
+            uses.push_back(std::move(common));
+        }
+
+        // No sharing left: chain each output's remaining terms
+        program.outputs.assign(outputs, kZero);
+        for (size_t r = 0; r < outputs; r++)
+        {
+            uint32_t acc = kZero;
+            for (uint32_t s = 0; s < uses.size(); s++)
+            {
+                if (!testBit(uses[s], r))
+                    continue;
+                if (acc == kZero)
+                {
+                    acc = s;
+                }
+                else
+                {
+                    program.ops.push_back({ acc, s });
+                    acc = program.inputCount + uint32_t(program.ops.size()) - 1;
+                }
+            }
+            program.outputs[r] = acc;
+        }
+        return program;
+    }
+
+    size_t xorCount() const { return ops.size(); }
+    size_t inputs() const { return inputCount; }
+    size_t toggles() const { return toggleCount; }
+    size_t checks() const { return outputs.size() - toggleCount; }
+
+    //================================================================================
+    // Method: run
+    // Description: Interprets the program. Word may be a single bit (uint8_t)
+    //              or a bit-sliced lane word holding one cell of many boxes.
+    //              Writes all outputs: toggles first, then checks.
+    //================================================================================
+    template <typename Word>
+    void run(const Word* in, Word* out, std::vector<Word>& signals) const
+    {
+        signals.resize(inputCount + ops.size());
+        std::copy(in, in + inputCount, signals.begin());
+        Word* s = signals.data();
+        Word* t = s + inputCount;
+        for (size_t k = 0; k < ops.size(); k++)
+            t[k] = s[ops[k].a] ^ s[ops[k].b];
+        for (size_t r = 0; r < outputs.size(); r++)
+            out[r] = outputs[r] == kZero ? Word() : s[outputs[r]];
+    }
+
+    //================================================================================
+    // Method: runPacked
+    // Description: Interprets the program on a packed state: the inputs are
+    //              unpacked a word at a time into one byte per signal and the
+    //              toggles are packed straight into the answer. signals is
+    //              caller-owned scratch, reused across calls.
+    //              Returns false if any check output is set.
+    //================================================================================
+    bool runPacked(const uint64_t* in, uint64_t* ans, std::vector<uint8_t>& signals) const
+    {
+        signals.resize(inputCount + ops.size() + 1);
+        uint8_t* s = signals.data();
+        s[inputCount + ops.size()] = 0; // kZero outputs read this slot
+        for (size_t p = 0; p < inputCount; p += 64)
+        {
+            const uint64_t w = in[p / 64];
+            const size_t len = std::min<size_t>(64, inputCount - p);
+            for (size_t k = 0; k < len; k++)
+                s[p + k] = uint8_t((w >> k) & 1);
+        }
+
+        uint8_t* t = s + inputCount;
+        for (size_t k = 0; k < ops.size(); k++)
+            t[k] = s[ops[k].a] ^ s[ops[k].b];
+
+        const uint32_t zero = uint32_t(inputCount + ops.size());
+        auto signal = [&](uint32_t i) { return s[i == kZero ? zero : i]; };
+        uint8_t failed = 0;
+        for (size_t r = toggleCount; r < outputs.size(); r++)
+            failed |= signal(outputs[r]);
+        if (failed)
+            return false;
+
+        for (size_t r = 0; r < toggleCount; r += 64)
+        {
+            uint64_t w = 0;
+            const size_t len = std::min<size_t>(64, toggleCount - r);
+            for (size_t k = 0; k < len; k++)
+                w |= uint64_t(signal(outputs[r + k])) << k;
+            ans[r / 64] = w;
+        }
+        return true;
+    }
+
+    //================================================================================
+    // Method: emitCpp
+    // Description: Writes the program as a standalone C++ function
+    //                  bool name(const uint8_t* s, uint8_t* ans)
+    //              that returns true if the state is solvable.
+    //================================================================================
+    void emitCpp(std::ostream& os, const std::string& name) const
+    {
+        auto signal = [&](uint32_t s) {
+            if (s == kZero)
+                return std::string("0");
+            if (s < inputCount)
+                return "s[" + std::to_string(s) + "]";
+            return "t[" + std::to_string(s - inputCount) + "]";
+        };
+
+        os << "// Generated XOR program: " << inputCount << " inputs, " << ops.size() << " XORs\n";
+        os << "bool " << name << "(const uint8_t* s, uint8_t* ans)\n{\n";
+        os << "    uint8_t t[" << std::max<size_t>(ops.size(), 1) << "];\n";
+        for (size_t k = 0; k < ops.size(); k++)
+            os << "    t[" << k << "] = " << signal(ops[k].a) << " ^ " << signal(ops[k].b) << ";\n";
+        for (size_t r = 0; r < toggleCount; r++)
+            os << "    ans[" << r << "] = " << signal(outputs[r]) << ";\n";
+        os << "    return (0";
+        for (size_t r = toggleCount; r < outputs.size(); r++)
+            os << " | " << signal(outputs[r]);
+        os << ") == 0;\n}\n";
+    }
+
+private:
+    uint32_t inputCount = 0;
+    size_t toggleCount = 0;
+    std::vector<Op> ops;
+    std::vector<uint32_t> outputs;
+};
+
+//================================================================================
+// Function: compileSolveMap
+// Description: Stacks the solution and check matrices of a solve map into one
+//              linear map and compiles it.
+//================================================================================
+XorProgram compileSolveMap(const SolveMap& map)
+{
+    const size_t boxSize = map.solution.rows();
+    BitMatrix combined(boxSize + map.checks.rows(), boxSize);
+    for (size_t r = 0; r < boxSize; r++)
+        std::copy(map.solution.row(r), map.solution.row(r) + map.solution.words(), combined.row(r));
+    for (size_t r = 0; r < map.checks.rows(); r++)
+        std::copy(map.checks.row(r), map.checks.row(r) + map.checks.words(), combined.row(boxSize + r));
+    return XorProgram::compile(combined, boxSize);
+}
+
+std::mutex compiledProgramsLock;
+std::map<std::pair<uint32_t, uint32_t>, XorProgram> compiledPrograms;
+
+//================================================================================
+// Function: compileShape
+// Description: Compiles (once) the XOR program for a hot (y, x) shape.
+//              Compilation is quadratic in the number of signals, so it is
+//              meant for small shapes that are solved many times.
+//================================================================================
+const XorProgram& compileShape(uint32_t y, uint32_t x)
+{
+    const SolveMap& map = cachedSolveMap(y, x);
+    std::lock_guard<std::mutex> guard(compiledProgramsLock);
+    auto it = compiledPrograms.find({ y, x });
+    if (it == compiledPrograms.end())
+        it = compiledPrograms.emplace(std::make_pair(y, x), compileSolveMap(map)).first;
+    return it->second;
+}
+
+//================================================================================
+// Function: findCompiledProgram
+// Description: Returns the compiled program for (y, x), or nullptr if the
+//              shape has not been compiled.
+//================================================================================
+const XorProgram* findCompiledProgram(uint32_t y, uint32_t x)
+{
+    std::lock_guard<std::mutex> guard(compiledProgramsLock);
+    auto it = compiledPrograms.find({ y, x });
+    return it == compiledPrograms.end() ? nullptr : &it->second;
+}
+
+//================================================================================
+// Function: solveCompiled
+// Description: Solves a packed state with a compiled XOR program. The signal
+//              scratch is per thread, so a warm call allocates nothing.
+//              Returns true if the state is solvable.
+//================================================================================
+bool solveCompiled(const XorProgram& program, const BitVector& state, BitVector& ans)
+{
+    thread_local std::vector<uint8_t> signals;
+    ans.resize(wordCount(program.toggles()));
+    return program.runPacked(state.data(), ans.data(), signals);
+}
+
+//================================================================================
+// Struct: SliceWord
+// Description: A bit-sliced lane word: bit b of a slice holds one cell of box
+//              b, so one XOR on a SliceWord<L> processes 64 * L boxes. The
+//              fixed-size loops are left for the compiler to vectorize.
+//================================================================================
+template <size_t Lanes>
+struct SliceWord
+{
+    static constexpr size_t kLanes = Lanes;
+    static constexpr size_t kBoxes = 64 * Lanes;
+
+    uint64_t w[Lanes] = {};
+
+    SliceWord operator^(const SliceWord& other) const
+    {
+        SliceWord out;
+        for (size_t l = 0; l < Lanes; l++)
+            out.w[l] = w[l] ^ other.w[l];
+        return out;
+    }
+
+    SliceWord& operator|=(const SliceWord& other)
+    {
+        for (size_t l = 0; l < Lanes; l++)
+            w[l] |= other.w[l];
+        return *this;
+    }
+
+    bool lane(size_t b) const { return (w[b / 64] >> (b % 64)) & 1; }
+};
+
+using Slice64 = SliceWord<1>;
+using Slice256 = SliceWord<4>;
+using Slice512 = SliceWord<8>;
+
+//================================================================================
+// Function: sliceStates
+// Description: Transposes up to Word::kBoxes packed box states into bit-sliced
+//              form: slices[p] holds cell p of every box in the group. Works on
+//              64-box x 64-cell tiles with transpose64.
+//================================================================================
+template <typename Word>
+void sliceStates(const BitVector* states, size_t count, size_t cells, Word* slices)
+{
+    uint64_t tile[64];
+    for (size_t l = 0; l * 64 < Word::kBoxes; l++)
+    {
+        for (size_t w = 0; w < wordCount(cells); w++)
+        {
+            for (size_t i = 0; i < 64; i++)
+                tile[i] = l * 64 + i < count ? states[l * 64 + i][w] : 0;
+
+            transpose64(tile);
+
+            for (size_t i = 0; i < 64 && w * 64 + i < cells; i++)
+                slices[w * 64 + i].w[l] = tile[i];
+        }
+    }
+}
+
+//================================================================================
+// Function: unsliceStates
+// Description: Inverse of sliceStates: writes cell p of box b back into
+//              states[b].
+//================================================================================
+template <typename Word>
+void unsliceStates(const Word* slices, size_t count, size_t cells, BitVector* states)
+{
+    for (size_t b = 0; b < count; b++)
+        states[b].assign(wordCount(cells), 0);
+
+    uint64_t tile[64];
+    for (size_t l = 0; l * 64 < count; l++)
+    {
+        for (size_t w = 0; w < wordCount(cells); w++)
+        {
+            for (size_t i = 0; i < 64; i++)
+                tile[i] = w * 64 + i < cells ? slices[w * 64 + i].w[l] : 0;
+
+            transpose64(tile);
+
+            for (size_t i = 0; i < 64 && l * 64 + i < count; i++)
+                states[l * 64 + i][w] = tile[i];
+        }
+    }
+}
+
+//================================================================================
+// Function: solveSlicedGroup
+// Description: Solves one group of up to Word::kBoxes same-shape states with a
+//              single pass of the compiled program over slice words.
+//================================================================================
+template <typename Word>
+void solveSlicedGroup(const XorProgram& program, const BitVector* states, size_t count,
+                      BitVector* answers, std::vector<bool>::iterator solvable)
+{
+    const size_t boxSize = program.inputs();
+    std::vector<Word> in(boxSize), out(program.toggles() + program.checks()), signals;
+
+    sliceStates(states, count, boxSize, in.data());
+    program.run(in.data(), out.data(), signals);
+    unsliceStates(out.data(), count, boxSize, answers);
+
+    // A box is unsolvable if any of its consistency checks fired
+    Word failed;
+    for (size_t r = program.toggles(); r < out.size(); r++)
+        failed |= out[r];
+    for (size_t b = 0; b < count; b++)
+        solvable[b] = !failed.lane(b);
+}
+
+//================================================================================
+// Function: solveBatch
+// Description: Bit-sliced batch counterpart of openBox for many boxes of the
+//              same (y, x) shape. Each state is solved with the shape's
+//              compiled program, 512 boxes per program pass. answers[b] is
+//              only meaningful when solvable[b] is true.
+//================================================================================
+void solveBatch(const XorProgram& program, const std::vector<BitVector>& states,
+                std::vector<BitVector>& answers, std::vector<bool>& solvable)
+{
+    TraceSpan span("solve batch");
+    answers.resize(states.size());
+    solvable.resize(states.size());
+
+    for (size_t first = 0; first < states.size(); first += Slice512::kBoxes)
+    {
+        TraceSpan group("sliced group");
+        const size_t count = std::min(Slice512::kBoxes, states.size() - first);
+        if (count <= Slice64::kBoxes)
+            solveSlicedGroup<Slice64>(program, &states[first], count, &answers[first], solvable.begin() + first);
+        else if (count <= Slice256::kBoxes)
+            solveSlicedGroup<Slice256>(program, &states[first], count, &answers[first], solvable.begin() + first);
+        else
+            solveSlicedGroup<Slice512>(program, &states[first], count, &answers[first], solvable.begin() + first);
+    }
+}
+
+void solveBatch(uint32_t y, uint32_t x, const std::vector<BitVector>& states,
+                std::vector<BitVector>& answers, std::vector<bool>& solvable)
+{
+    solveBatch(compileShape(y, x), states, answers, solvable);
+}
+
+//================================================================================
+// Random generators
+// Description: Anything with uint64_t operator()() can drive the bulk
+//              generators below (std::mt19937_64 included). Wyrand and
+//              Xoshiro256Streams are much cheaper choices for generating
+//              test inputs.
+//================================================================================
+
+//================================================================================
+// Function: boundedRandom
+// Description: Maps a 64-bit random value to [0, range) with a multiply and
+//              a shift instead of a division.
+//================================================================================
+inline uint32_t boundedRandom(uint64_t r, uint32_t range)
+{
+    return uint32_t(((r >> 32) * range) >> 32);
+}
+
+//================================================================================
+// Function: splitMix64
+// Description: Seed expander used to initialize generator states.
+//================================================================================
+inline uint64_t splitMix64(uint64_t& seed)
+{
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+//================================================================================
+// Class: Wyrand
+// Description: wyrand: one add and one 64x64->128 multiply per output.
+//================================================================================
+class Wyrand
+{
+public:
+    explicit Wyrand(uint64_t seed = 0) : state(seed) {}
+
+    uint64_t operator()()
+    {
+        state += 0xA0761D6478BD642Full;
+        const __uint128_t product = __uint128_t(state) * (state ^ 0xE7037ED1A0B428DBull);
+        return uint64_t(product >> 64) ^ uint64_t(product);
+    }
+
+private:
+    uint64_t state;
+};
+
+//================================================================================
+// Class: Xoshiro256Streams
+// Description: Lanes independent xoshiro256** streams advanced together. The
+//              state is stored lane-minor, so each step is a handful of
+//              fixed-length loops the compiler turns into SIMD operations.
+//              fill() writes whole blocks; operator() hands out one value at
+//              a time from the current block.
+//================================================================================
+template <size_t Lanes>
+class Xoshiro256Streams
+{
+public:
+    explicit Xoshiro256Streams(uint64_t seed = 0)
+    {
+        for (size_t k = 0; k < 4; k++)
+            for (size_t l = 0; l < Lanes; l++)
+                s[k][l] = splitMix64(seed);
+    }
+
+    void fill(uint64_t* out, size_t count)
+    {
+        while (count >= Lanes)
+        {
+            step(out);
+            out += Lanes;
+            count -= Lanes;
+        }
+        for (; count; count--)
+            *out++ = (*this)();
+    }
+
+    uint64_t operator()()
+    {
+        if (next == Lanes)
+        {
+            step(block);
+            next = 0;
+        }
+        return block[next++];
+    }
+
+private:
+    uint64_t s[4][Lanes];
+    uint64_t block[Lanes];
+    size_t next = Lanes;
+
+    static uint64_t rotl(uint64_t v, int k) { return (v << k) | (v >> (64 - k)); }
+
+    void step(uint64_t* out)
+    {
+        for (size_t l = 0; l < Lanes; l++)
+        {
+            out[l] = rotl(s[1][l] * 5, 7) * 9;
+            const uint64_t t = s[1][l] << 17;
+            s[2][l] ^= s[0][l];
+            s[3][l] ^= s[1][l];
+            s[1][l] ^= s[2][l];
+            s[0][l] ^= s[3][l];
+            s[2][l] ^= t;
+            s[3][l] = rotl(s[3][l], 45);
+        }
+    }
+};
+
+//================================================================================
+// Function: shuffleBox
+// Description: The SecureBox::shuffle procedure (up to 999 random toggles)
+//              for any box type with toggle(y, x), on any generator, with
+//              multiply-shift range reduction.
+//================================================================================
+template <typename Box, typename Generator>
+void shuffleBox(Box& box, uint32_t y, uint32_t x, Generator& rng)
+{
+    TraceSpan span("shuffle");
+    for (uint32_t t = boundedRandom(rng(), 1000); t > 0; t--)
+    {
+        const uint64_t r = rng();
+        box.toggle(boundedRandom(r, y), boundedRandom(r << 32, x));
+    }
+}
+
+//================================================================================
+// Class: BoxFleet
+// Description: Many same-shaped boxes in one contiguous bit-packed buffer,
+//              stored structure-of-arrays across boxes: cell p of every box
+//              lives in words[p * lanes .. p * lanes + lanes), bit b of that
+//              run being box b. This is the bit-sliced layout, so batched
+//              operations walk memory linearly and vectorize across boxes,
+//              and whole-fleet import/export goes through the transpose
+//              kernels.
+//================================================================================
+class BoxFleet
+{
+public:
+    BoxFleet(size_t count, uint32_t y, uint32_t x)
+        : boxCount(count), ySize(y), xSize(x), lanes(wordCount(count)), words(size_t(y) * x * lanes, 0)
+    {
+    }
+
+    size_t size() const { return boxCount; }
+    uint32_t height() const { return ySize; }
+    uint32_t width() const { return xSize; }
+
+    //================================================================================
+    // Method: toggle
+    // Description: Same operation as SecureBox::toggle, applied to one box.
+    //================================================================================
+    void toggle(size_t box, uint32_t y, uint32_t x)
+    {
+        const uint64_t bit = uint64_t(1) << (box % 64);
+        for (uint32_t i = 0; i < xSize; i++)
+            cell(y, i)[box / 64] ^= bit;
+        for (uint32_t i = 0; i < ySize; i++)
+            if (i != y)
+                cell(i, x)[box / 64] ^= bit;
+    }
+
+    //================================================================================
+    // Method: toggle
+    // Description: Toggles (y, x) in every box whose bit is set in boxes.
+    //              Bits past the last box are ignored, so the padding of the
+    //              last lane stays zero.
+    //================================================================================
+    void toggle(uint32_t y, uint32_t x, const BitVector& boxes)
+    {
+        for (uint32_t i = 0; i < xSize; i++)
+            xorLanes(cell(y, i), boxes);
+        for (uint32_t i = 0; i < ySize; i++)
+            if (i != y)
+                xorLanes(cell(i, x), boxes);
+    }
+
+    //================================================================================
+    // Method: shuffle
+    // Description: Toggles every cell in a random half of the boxes, which
+    //              gives each box a uniformly random reachable state. Masks
+    //              come from the generator in bulk when it supports fill().
+    //================================================================================
+    template <typename Generator>
+    void shuffle(Generator& rng)
+    {
+        BitVector boxes(lanes);
+        for (uint32_t i = 0; i < ySize; i++)
+        {
+            for (uint32_t j = 0; j < xSize; j++)
+            {
+                fillRandom(rng, boxes);
+                toggle(i, j, boxes);
+            }
+        }
+    }
+
+    //================================================================================
+    // Method: isLocked
+    // Description: Returns true if any cell of the box is true (locked).
+    //================================================================================
+    bool isLocked(size_t box) const
+    {
+        for (size_t p = 0; p < size_t(ySize) * xSize; p++)
+            if ((words[p * lanes + box / 64] >> (box % 64)) & 1)
+                return true;
+        return false;
+    }
+
+    //================================================================================
+    // Method: lockedBoxes
+    // Description: Returns the set of locked boxes: the OR of all cells, one
+    //              linear pass over the buffer.
+    //================================================================================
+    BitVector lockedBoxes() const
+    {
+        BitVector locked(lanes, 0);
+        for (size_t p = 0; p < size_t(ySize) * xSize; p++)
+            for (size_t l = 0; l < lanes; l++)
+                locked[l] |= words[p * lanes + l];
+        return locked;
+    }
+
+    //================================================================================
+    // Method: getState
+    // Description: Returns a copy of one box in SecureBox::getState form.
+    //================================================================================
+    std::vector<std::vector<bool>> getState(size_t box) const
+    {
+        std::vector<std::vector<bool>> state(ySize, std::vector<bool>(xSize));
+        for (uint32_t i = 0; i < ySize; i++)
+            for (uint32_t j = 0; j < xSize; j++)
+                state[i][j] = (cell(i, j)[box / 64] >> (box % 64)) & 1;
+        return state;
+    }
+
+    //================================================================================
+    // Method: exportStates / importStates
+    // Description: Converts the whole fleet to and from packed row-major box
+    //              states, 64 boxes x 64 cells per transpose64 tile.
+    //================================================================================
+    std::vector<BitVector> exportStates() const
+    {
+        const size_t boxSize = size_t(ySize) * xSize;
+        std::vector<BitVector> states(boxCount);
+        std::vector<Slice64> group(boxSize);
+        for (size_t l = 0; l < lanes; l++)
+        {
+            for (size_t p = 0; p < boxSize; p++)
+                group[p].w[0] = words[p * lanes + l];
+            unsliceStates(group.data(), std::min<size_t>(64, boxCount - l * 64), boxSize, &states[l * 64]);
+        }
+        return states;
+    }
+
+    void importStates(const std::vector<BitVector>& states)
+    {
+        const size_t boxSize = size_t(ySize) * xSize;
+        std::vector<Slice64> group(boxSize);
+        for (size_t l = 0; l < lanes; l++)
+        {
+            sliceStates(&states[l * 64], std::min<size_t>(64, boxCount - l * 64), boxSize, group.data());
+            for (size_t p = 0; p < boxSize; p++)
+                words[p * lanes + l] = group[p].w[0];
+        }
+    }
+
+private:
+    size_t boxCount;
+    uint32_t ySize, xSize;
+    size_t lanes;
+    std::vector<uint64_t> words;
+
+    uint64_t* cell(uint32_t y, uint32_t x) { return words.data() + (size_t(y) * xSize + x) * lanes; }
+    const uint64_t* cell(uint32_t y, uint32_t x) const { return words.data() + (size_t(y) * xSize + x) * lanes; }
+
+    template <typename Generator>
+    auto fillRandom(Generator& rng, BitVector& out) -> decltype(rng.fill(out.data(), out.size()))
+    {
+        return rng.fill(out.data(), out.size());
+    }
+
+    template <typename Generator, typename... Ignored>
+    void fillRandom(Generator& rng, BitVector& out, Ignored...)
+    {
+        for (uint64_t& w : out)
+            w = rng();
+    }
+
+    void xorLanes(uint64_t* dst, const BitVector& boxes)
+    {
+        if (lanes == 0)
+            return;
+        for (size_t l = 0; l + 1 < lanes; l++)
+            dst[l] ^= boxes[l];
+        const uint64_t lastMask = boxCount % 64 ? (uint64_t(1) << (boxCount % 64)) - 1 : ~uint64_t(0);
+        dst[lanes - 1] ^= boxes[lanes - 1] & lastMask;
+    }
+};
+
+//================================================================================
+// Class: ConcurrentBox
+// Description: A box that several threads can toggle at once without a lock.
+//              Rows are packed into word-aligned runs of atomic words and a
+//              toggle is a set of fetch_xor operations. Toggles commute in
+//              GF(2), so the state after all toggling threads finish does not
+//              depend on how their word updates interleaved.
+//
+//              Readers get consistent snapshots through a multi-writer
+//              seqlock: every toggle bumps `started` before its word updates
+//              and `finished` after them. A reader copies the words when the
+//              two counters agree and keeps the copy if `started` has not
+//              moved meanwhile, i.e. no toggle overlapped the copy. Writers
+//              never wait; a reader retries instead.
+//================================================================================
+class ConcurrentBox
+{
+public:
+    ConcurrentBox(uint32_t y, uint32_t x)
+        : ySize(y), xSize(x), stride(wordCount(x)), words(new std::atomic<uint64_t>[size_t(y) * stride]())
+    {
+    }
+
+    explicit ConcurrentBox(const std::vector<std::vector<bool>>& state)
+        : ConcurrentBox(uint32_t(state.size()), state.empty() ? 0 : uint32_t(state[0].size()))
+    {
+        for (uint32_t i = 0; i < ySize; i++)
+            for (uint32_t j = 0; j < xSize; j++)
+                if (state[i][j])
+                    word(i, j).fetch_xor(bit(j), std::memory_order_relaxed);
+    }
+
+    uint32_t height() const { return ySize; }
+    uint32_t width() const { return xSize; }
+
+    //================================================================================
+    // Method: toggle
+    // Description: Same operation as SecureBox::toggle: flips row y with
+    //              whole-word XORs, then bit x of every other row.
+    //================================================================================
+    void toggle(uint32_t y, uint32_t x)
+    {
+        started.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::atomic<uint64_t>* row = words.get() + size_t(y) * stride;
+        for (size_t w = 0; w < stride; w++)
+        {
+            const size_t used = std::min<size_t>(64, xSize - w * 64);
+            row[w].fetch_xor(used == 64 ? ~uint64_t(0) : (uint64_t(1) << used) - 1, std::memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < ySize; i++)
+            if (i != y)
+                word(i, x).fetch_xor(bit(x), std::memory_order_relaxed);
+
+        finished.fetch_add(1, std::memory_order_release);
+    }
+
+    //================================================================================
+    // Method: trySnapshot
+    // Description: Copies the packed rows (stride words per row) into out if a
+    //              consistent copy is obtained within the given number of
+    //              attempts. Returns true on success.
+    //================================================================================
+    bool trySnapshot(std::vector<uint64_t>& out, int attempts) const
+    {
+        out.resize(size_t(ySize) * stride);
+        for (int attempt = 0; attempt < attempts; attempt++)
+        {
+            const uint64_t done = finished.load(std::memory_order_acquire);
+            const uint64_t begun = started.load(std::memory_order_acquire);
+            if (begun != done)
+                continue;
+
+            for (size_t w = 0; w < out.size(); w++)
+                out[w] = words[w].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (started.load(std::memory_order_relaxed) == begun)
+                return true;
+        }
+        return false;
+    }
+
+    //================================================================================
+    // Method: snapshot
+    // Description: Consistent copy of the packed rows; yields between failed
+    //              attempts while toggles are in flight.
+    //================================================================================
+    std::vector<uint64_t> snapshot() const
+    {
+        std::vector<uint64_t> out;
+        while (!trySnapshot(out, 64))
+            std::this_thread::yield();
+        return out;
+    }
+
+    //================================================================================
+    // Method: isLocked
+    // Description: Returns true if any cell is true (locked), on a consistent
+    //              snapshot.
+    //================================================================================
+    bool isLocked() const
+    {
+        const std::vector<uint64_t> rows = snapshot();
+        return std::any_of(rows.begin(), rows.end(), [](uint64_t w) { return w != 0; });
+    }
+
+    //================================================================================
+    // Method: getState
+    // Description: Returns a consistent copy of the current state.
+    //================================================================================
+    std::vector<std::vector<bool>> getState() const
+    {
+        const std::vector<uint64_t> rows = snapshot();
+        std::vector<std::vector<bool>> state(ySize, std::vector<bool>(xSize));
+        for (uint32_t i = 0; i < ySize; i++)
+            for (uint32_t j = 0; j < xSize; j++)
+                state[i][j] = rows[size_t(i) * stride + j / 64] & bit(j);
+        return state;
+    }
+
+private:
+    uint32_t ySize, xSize;
+    size_t stride;
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    std::atomic<uint64_t> started{ 0 }, finished{ 0 };
+
+    std::atomic<uint64_t>& word(uint32_t y, uint32_t x) const { return words[size_t(y) * stride + x / 64]; }
+    static uint64_t bit(uint32_t x) { return uint64_t(1) << (x % 64); }
+};
+
+//================================================================================
+// Function: solveGaussJordan
+// Description: Reference solver: builds the toggle system for the packed state
+//              and solves it by Gauss-Jordan elimination modulo two.
+//              Returns true if the state is solvable.
+//================================================================================
+bool solveGaussJordan(const BitVector& state, uint32_t y, uint32_t x, BitVector& ans)
+{
+    const size_t boxSize = size_t(y) * x;
+
+    // Matrix of valid configurations for the box matrix of size boxSize...boxSize + 1
+    std::vector<std::vector<int>> matrix(boxSize, std::vector<int>(boxSize + 1, 0));
+    TraceSpan build("build matrix");
+
+    /*
+    * Formula: sum(a,b) = (i==a | j==b),
+    * where valid configurations are equal to L(a,b) = XOR state(i,j);
+    */
+
+    // Constructing the matrix and storing the initial box matrix
+    for (uint32_t i = 0; i < y; i++)
+    {
+        for (uint32_t j = 0; j < x; j++)
+        {
+
+            // Index for the matrix
+            size_t p = size_t(i) * x + j;
+
+            // Insert the initial box matrix into the system matrix
+            matrix[p][boxSize] = testBit(state, p) ? 1 : 0;
+
+            // Marking the effects of toggle as valid configurations for column cells j
+            for (uint32_t a = 0; a < y; a++)
+            {
+                size_t q = size_t(a) * x + j;
+                matrix[p][q] = 1;
+            }
+            // Marking the effects of toggle as valid configurations for row cells i
+            for (uint32_t b = 0; b < x; b++)
+            {
+                size_t q = size_t(i) * x + b;
+                matrix[p][q] = 1;
+            }
+        }
+    }
+
+    // Solving using Gauss-Jordan elimination modulo two, traced in panels of 64 columns.
+    build.close();
+    TraceSpan panel("elimination panel");
+
+    size_t row = 0;
+    std::vector<int64_t> index(boxSize, -1);
+    for (size_t col = 0; col < boxSize && row < boxSize; col++)
+    {
+        if (col && col % 64 == 0)
+            panel.next();
+
+        int64_t pivot = -1;
+        // Finding a 1 in the column to use as a pivot value.
+        for (size_t r = row; r < boxSize; r++)
+        {
+            if (matrix[r][col] == 1)
+            {
+                pivot = int64_t(r);
+                break;
+            }
+        }
+
+        if (pivot == -1)
+        {
+            continue;
+        }
+
+        if (size_t(pivot) != row)
+        {
+            std::swap(matrix[row], matrix[pivot]);
+        }
+
+        index[col] = int64_t(row);
+        // Zeroing out column col for all rows
+        for (size_t r = 0; r < boxSize; r++)
+        {
+            if (r != row && matrix[r][col] == 1)
+            {
+                for (size_t c = col; c <= boxSize; c++)
+                {
+                    // Using XOR as subtraction 
+                    matrix[r][c] ^= matrix[row][c];
+                }
+            }
+        }
+        row++;
+    }
+    // Checking system consistency. If a row has no ones except for the last column, there is no solution.
+    panel.close();
+    TraceSpan check("consistency check");
+    for (size_t r = row; r < boxSize; r++)
+    {
+        if (matrix[r][boxSize] == 1)
+        {
+            return false;
+        }
+    }
+    // Assigning 0 to free variables
+    ans.assign(wordCount(boxSize), 0);
+    for (size_t col = 0; col < boxSize; col++)
+    {
+        if (index[col] != -1 && matrix[index[col]][boxSize] == 1)
+        {
+            flipBit(ans, col);
+        }
+    }
+    return true;
+}
+
+//================================================================================
+// Struct: EliminationState
+// Description: Everything needed to continue a packed Gauss-Jordan
+//              elimination: the augmented matrix, the pivot index per column
+//              and the next column and pivot row.
+//================================================================================
+struct EliminationState
+{
+    uint32_t y = 0, x = 0;
+    uint64_t col = 0, row = 0;
+    std::vector<int64_t> index;
+    BitMatrix matrix;
+};
+
+//================================================================================
+// Class: CheckpointWriter
+// Description: Writes checkpoints in the background. On POSIX systems a
+//              checkpoint is written by a forked child from its
+//              copy-on-write view of the state, so the elimination neither
+//              copies the matrix nor waits; pages are only duplicated as the
+//              elimination rewrites them while the child is still writing.
+//              Elsewhere the state is copied to a writer thread. If the
+//              previous checkpoint is still being written the new one is
+//              dropped rather than stalling the elimination. Each file is
+//              written to a temporary name, synced and renamed, so a crash or
+//              preemption mid-write keeps the last complete checkpoint.
+//
+//              File layout: "SBC1" magic, y, x (uint32), col, row (uint64),
+//              the index array (int64 per cell), then the matrix words.
+//================================================================================
+class CheckpointWriter
+{
+public:
+    static constexpr uint32_t kMagic = 0x31434253; // "SBC1"
+
+    explicit CheckpointWriter(const std::string& file) : path(file) {}
+
+#if defined(__unix__) || defined(__APPLE__)
+    ~CheckpointWriter()
+    {
+        if (child > 0)
+            while (waitpid(child, nullptr, 0) < 0 && errno == EINTR)
+                continue;
+    }
+
+    //================================================================================
+    // Method: submit
+    // Description: Starts writing a snapshot of the state unless a write is
+    //              still in flight. Returns true if the checkpoint was taken.
+    //================================================================================
+    bool submit(const EliminationState& state)
+    {
+        if (child > 0)
+        {
+            if (waitpid(child, nullptr, WNOHANG) == 0)
+                return false;
+            child = -1;
+        }
+
+        const pid_t pid = fork();
+        if (pid == 0)
+            _exit(write(path, state) ? 0 : 1);
+        if (pid < 0)
+            return false;
+        child = pid;
+        return true;
+    }
+#else
+    ~CheckpointWriter()
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool submit(const EliminationState& state)
+    {
+        if (busy.load(std::memory_order_acquire))
+            return false;
+        if (worker.joinable())
+            worker.join();
+
+        busy.store(true, std::memory_order_release);
+        worker = std::thread([this, copy = state]() {
+            write(path, copy);
+            busy.store(false, std::memory_order_release);
+        });
+        return true;
+    }
+#endif
+
+    static bool write(const std::string& path, const EliminationState& state)
+    {
+        const std::string temp = path + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            const uint32_t header[3] = { kMagic, state.y, state.x };
+            const uint64_t position[2] = { state.col, state.row };
+            out.write(reinterpret_cast<const char*>(header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(position), sizeof(position));
+            out.write(reinterpret_cast<const char*>(state.index.data()), std::streamsize(state.index.size() * sizeof(int64_t)));
+            out.write(reinterpret_cast<const char*>(state.matrix.row(0)),
+                      std::streamsize(state.matrix.rows() * state.matrix.words() * sizeof(uint64_t)));
+            if (!out.flush())
+                return false;
+        }
+        if (!syncFile(temp) || std::rename(temp.c_str(), path.c_str()) != 0)
+            return false;
+
+        // Make the rename itself durable
+        const std::string directory = std::filesystem::path(path).parent_path().string();
+        return syncFile(directory.empty() ? "." : directory);
+    }
+
+    static bool read(const std::string& path, EliminationState& state)
+    {
+        std::ifstream in(path, std::ios::binary);
+        uint32_t header[3];
+        uint64_t position[2];
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kMagic ||
+            !in.read(reinterpret_cast<char*>(position), sizeof(position)))
+            return false;
+
+        const size_t boxSize = size_t(header[1]) * header[2];
+        state.y = header[1];
+        state.x = header[2];
+        state.col = position[0];
+        state.row = position[1];
+        state.index.assign(boxSize, -1);
+        state.matrix = BitMatrix(boxSize, boxSize + 1);
+        in.read(reinterpret_cast<char*>(state.index.data()), std::streamsize(boxSize * sizeof(int64_t)));
+        in.read(reinterpret_cast<char*>(state.matrix.row(0)),
+                std::streamsize(state.matrix.rows() * state.matrix.words() * sizeof(uint64_t)));
+        return bool(in);
+    }
+
+private:
+    std::string path;
+#if defined(__unix__) || defined(__APPLE__)
+    pid_t child = -1;
+#else
+    std::thread worker;
+    std::atomic<bool> busy{ false };
+#endif
+
+    // Flushes a file's (or directory's) data to stable storage
+    static bool syncFile(const std::string& name)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = open(name.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        const bool synced = fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+#else
+        (void)name;
+        return true;
+#endif
+    }
+};
+
+//================================================================================
+// Function: continueElimination
+// Description: Runs a packed Gauss-Jordan elimination from the saved
+//              position, submitting a checkpoint every `interval` columns,
+//              and removes the checkpoint once the solve is complete.
+//              Returns true if the state is solvable.
+//================================================================================
+bool continueElimination(EliminationState& state, const std::string& path, size_t interval, BitVector& ans)
+{
+    const size_t boxSize = size_t(state.y) * state.x;
+    BitMatrix& matrix = state.matrix;
+    {
+        CheckpointWriter writer(path);
+        TraceSpan panel("elimination panel");
+        for (; state.col < boxSize && state.row < boxSize; state.col++)
+        {
+            if (state.col % 64 == 0)
+                panel.next();
+            if (interval && state.col % interval == 0)
+                writer.submit(state);
+
+            size_t pivot = state.row;
+            while (pivot < boxSize && !matrix.get(pivot, state.col))
+                pivot++;
+            if (pivot == boxSize)
+                continue;
+
+            matrix.swapRows(state.row, pivot);
+            state.index[state.col] = int64_t(state.row);
+            for (size_t r = 0; r < boxSize; r++)
+                if (r != state.row && matrix.get(r, state.col))
+                    matrix.xorRow(r, state.row, state.col / 64);
+            state.row++;
+        }
+    }
+    std::remove(path.c_str());
+
+    TraceSpan check("consistency check");
+    for (size_t r = state.row; r < boxSize; r++)
+        if (matrix.get(r, boxSize))
+            return false;
+
+    ans.assign(wordCount(boxSize), 0);
+    for (size_t col = 0; col < boxSize; col++)
+        if (state.index[col] != -1 && matrix.get(size_t(state.index[col]), boxSize))
+            flipBit(ans, col);
+    return true;
+}
+
+//================================================================================
+// Function: solveCheckpointed
+// Description: Packed Gauss-Jordan solve that checkpoints to `path` every
+//              `interval` columns, for long eliminations on preemptible
+//              nodes. Returns true if the state is solvable.
+//================================================================================
+bool solveCheckpointed(const BitVector& state, uint32_t y, uint32_t x, BitVector& ans,
+                       const std::string& path, size_t interval)
+{
+    const size_t boxSize = size_t(y) * x;
+    EliminationState elimination;
+    elimination.y = y;
+    elimination.x = x;
+    elimination.index.assign(boxSize, -1);
+    elimination.matrix = BitMatrix(boxSize, boxSize + 1);
+
+    const BitMatrix system = buildToggleSystem(y, x);
+    for (size_t r = 0; r < boxSize; r++)
+    {
+        std::copy(system.row(r), system.row(r) + system.words(), elimination.matrix.row(r));
+        if (testBit(state, r))
+            elimination.matrix.set(r, boxSize);
+    }
+    return continueElimination(elimination, path, interval, ans);
+}
+
+//================================================================================
+// Function: resumeCheckpointed
+// Description: Resumes an interrupted solveCheckpointed from its last
+//              checkpoint, checkpointing to the same file as it goes.
+//              Returns false if there is no readable checkpoint; otherwise
+//              sets solvable and, if solvable, the toggles for the y x x box
+//              stored in the checkpoint.
+//================================================================================
+bool resumeCheckpointed(const std::string& path, uint32_t& y, uint32_t& x, BitVector& ans,
+                        bool& solvable, size_t interval)
+{
+    EliminationState elimination;
+    if (!CheckpointWriter::read(path, elimination))
+        return false;
+    y = elimination.y;
+    x = elimination.x;
+    solvable = continueElimination(elimination, path, interval, ans);
+    return true;
+}
+
+//================================================================================
+// Class: SymmetricBitMatrix
+// Description: Symmetric GF(2) matrix that stores only the upper triangle.
+//              Row i keeps the words covering columns i..n-1, so rows stay
+//              word-aligned with full-length vectors and memory is roughly
+//              half of a BitMatrix of the same size.
+//================================================================================
+class SymmetricBitMatrix
+{
+public:
+    explicit SymmetricBitMatrix(size_t n) : size(n), stride(wordCount(n)), offset(n + 1, 0)
+    {
+        for (size_t i = 0; i < n; i++)
+            offset[i + 1] = offset[i] + stride - i / 64;
+        bits.assign(offset[n], 0);
+    }
+
+    size_t rows() const { return size; }
+    size_t words() const { return stride; }
+
+    // Row i as a full-length word array; only words i / 64 .. stride - 1 may be accessed.
+    uint64_t* row(size_t i) { return bits.data() + offset[i] - i / 64; }
+    const uint64_t* row(size_t i) const { return bits.data() + offset[i] - i / 64; }
+
+    bool get(size_t i, size_t j) const
+    {
+        if (i > j)
+            std::swap(i, j);
+        return (row(i)[j / 64] >> (j % 64)) & 1;
+    }
+
+    void set(size_t i, size_t j)
+    {
+        if (i > j)
+            std::swap(i, j);
+        row(i)[j / 64] |= uint64_t(1) << (j % 64);
+    }
+
+    //================================================================================
+    // Method: gatherRow
+    // Description: Expands row k to a full-length vector: columns below k come
+    //              from column k of the rows above it.
+    //================================================================================
+    void gatherRow(size_t k, BitVector& out) const
+    {
+        out.assign(stride, 0);
+        for (size_t j = 0; j < k; j++)
+            if ((row(j)[k / 64] >> (k % 64)) & 1)
+                flipBit(out, j);
+        for (size_t w = k / 64; w < stride; w++)
+            out[w] |= row(k)[w];
+    }
+
+    //================================================================================
+    // Method: xorIntoRow
+    // Description: Row i ^= v & mask over the stored columns i..n-1.
+    //================================================================================
+    void xorIntoRow(size_t i, const BitVector& v, const BitVector& mask)
+    {
+        uint64_t* r = row(i);
+        const size_t first = i / 64;
+        r[first] ^= v[first] & mask[first] & (~uint64_t(0) << (i % 64));
+        for (size_t w = first + 1; w < stride; w++)
+            r[w] ^= v[w] & mask[w];
+    }
+
+private:
+    size_t size, stride;
+    std::vector<size_t> offset;
+    std::vector<uint64_t> bits;
+};
+
+//================================================================================
+// Function: buildSymmetricToggleSystem
+// Description: Upper triangle of the toggle system matrix (see
+//              buildToggleSystem); the matrix is symmetric because "same row
+//              or same column" is a symmetric relation.
+//================================================================================
+SymmetricBitMatrix buildSymmetricToggleSystem(uint32_t y, uint32_t x)
+{
+    SymmetricBitMatrix system(size_t(y) * x);
+    for (uint32_t i = 0; i < y; i++)
+    {
+        for (uint32_t j = 0; j < x; j++)
+        {
+            size_t p = size_t(i) * x + j;
+            for (uint32_t a = i; a < y; a++)
+                system.set(p, size_t(a) * x + j);
+            for (uint32_t b = j; b < x; b++)
+                system.set(p, size_t(i) * x + b);
+        }
+    }
+    return system;
+}
+
+//================================================================================
+// Function: solveSymmetric
+// Description: Solves the toggle system with a GF(2) LDL^T-style elimination
+//              that keeps the active submatrix symmetric, so only its upper
+//              triangle is ever stored.
+//              Pivots are 1x1 (a diagonal 1) when possible; otherwise a 2x2
+//              block [[0,1],[1,0]] is used, which is the only invertible
+//              symmetric pivot left once the active diagonal is all zero.
+//              Each pivot applies the symmetric Schur update
+//                  1x1 k:    A_ij ^= A_ik A_kj
+//                  2x2 k,l:  A_ij ^= A_ik A_lj ^ A_il A_kj
+//              to the active rows only, which freezes the eliminated entries
+//              as the factor used by back substitution.
+//              Returns true if the state is solvable.
+//================================================================================
+bool solveSymmetric(const BitVector& state, uint32_t y, uint32_t x, BitVector& ans)
+{
+    const size_t boxSize = size_t(y) * x;
+    const size_t npos = SIZE_MAX;
+    SymmetricBitMatrix matrix = buildSymmetricToggleSystem(y, x);
+    BitVector rhs = state;
+    rhs.resize(wordCount(boxSize), 0);
+
+    BitVector active(wordCount(boxSize), 0);
+    for (size_t p = 0; p < boxSize; p++)
+        flipBit(active, p);
+
+    struct Pivot
+    {
+        size_t k, l;
+    };
+    std::vector<Pivot> pivots;
+    BitVector rowK, rowL;
+
+    for (;;)
+    {
+        // Prefer a diagonal pivot
+        size_t k = npos, l = npos;
+        for (size_t i = 0; i < boxSize && k == npos; i++)
+            if (testBit(active, i) && matrix.get(i, i))
+                k = i;
+
+        // Otherwise look for an off-diagonal 1 in the active submatrix
+        for (size_t i = 0; i < boxSize && k == npos; i++)
+        {
+            if (!testBit(active, i))
+                continue;
+            const uint64_t* r = matrix.row(i);
+            for (size_t w = i / 64; w < matrix.words() && k == npos; w++)
+            {
+                uint64_t hits = r[w] & active[w];
+                if (hits)
+                {
+                    k = i;
+                    l = w * 64 + countTrailingZeros64(hits);
+                }
+            }
+        }
+
+        if (k == npos)
+            break;
+
+        matrix.gatherRow(k, rowK);
+        flipBit(active, k);
+        if (l != npos)
+        {
+            matrix.gatherRow(l, rowL);
+            flipBit(active, l);
+        }
+
+        for (size_t w = 0; w < active.size(); w++)
+        {
+            for (uint64_t bits = active[w]; bits; bits &= bits - 1)
+            {
+                size_t i = w * 64 + countTrailingZeros64(bits);
+                if (l == npos)
+                {
+                    if (testBit(rowK, i))
+                    {
+                        matrix.xorIntoRow(i, rowK, active);
+                        rhs[i / 64] ^= uint64_t(testBit(rhs, k)) << (i % 64);
+                    }
+                }
+                else
+                {
+                    if (testBit(rowK, i))
+                    {
+                        matrix.xorIntoRow(i, rowL, active);
+                        rhs[i / 64] ^= uint64_t(testBit(rhs, l)) << (i % 64);
+                    }
+                    if (testBit(rowL, i))
+                    {
+                        matrix.xorIntoRow(i, rowK, active);
+                        rhs[i / 64] ^= uint64_t(testBit(rhs, k)) << (i % 64);
+                    }
+                }
+            }
+        }
+        pivots.push_back({ k, l });
+    }
+
+    // The remaining active submatrix is zero: its equations must be 0 = 0
+    for (size_t w = 0; w < active.size(); w++)
+        if (active[w] & rhs[w])
+            return false;
+
+    // Back substitution in reverse pivot order; unsolved and free variables are 0
+    ans.assign(wordCount(boxSize), 0);
+    auto dot = [&](const BitVector& r) {
+        uint64_t acc = 0;
+        for (size_t w = 0; w < r.size(); w++)
+            acc ^= r[w] & ans[w];
+        return popcount64(acc) & 1;
+    };
+    for (auto it = pivots.rbegin(); it != pivots.rend(); ++it)
+    {
+        matrix.gatherRow(it->k, rowK);
+        if (it->l == npos)
+        {
+            if (testBit(rhs, it->k) ^ dot(rowK))
+                flipBit(ans, it->k);
+        }
+        else
+        {
+            // Row k determines s_l and row l determines s_k
+            matrix.gatherRow(it->l, rowL);
+            bool sl = testBit(rhs, it->k) ^ dot(rowK);
+            bool sk = testBit(rhs, it->l) ^ dot(rowL);
+            if (sl)
+                flipBit(ans, it->l);
+            if (sk)
+                flipBit(ans, it->k);
+        }
+    }
+    return true;
+}
+
+//================================================================================
+// Tiny shapes
+// Description: Boxes with at most kTinyMaxCells cells are solved by a single
+//              table lookup indexed by the packed state. Each table is
+//              generated once per shape from its solve map and is read-only
+//              afterwards.
+//================================================================================
+constexpr size_t kTinyMaxCells = 20;
+constexpr uint32_t kTinyUnsolvable = UINT32_MAX;
+
+//================================================================================
+// Function: buildTinyTable
+// Description: Enumerates every state in Gray-code order, so each entry is the
+//              previous one XOR the response of a single cell (solving is
+//              linear). A response packs the cell's toggle column in the low
+//              bits and its consistency-check column above it; both columns
+//              are single words of the transposed maps.
+//================================================================================
+std::vector<uint32_t> buildTinyTable(uint32_t y, uint32_t x)
+{
+    const SolveMap& map = cachedSolveMap(y, x);
+    const size_t boxSize = size_t(y) * x;
+    const BitMatrix toggleColumns = map.solution.transposed();
+    const BitMatrix checkColumns = map.checks.transposed();
+
+    std::vector<uint64_t> response(boxSize, 0);
+    for (size_t p = 0; p < boxSize; p++)
+    {
+        response[p] = toggleColumns.row(p)[0];
+        if (checkColumns.words())
+            response[p] |= checkColumns.row(p)[0] << boxSize;
+    }
+
+    const uint64_t toggleMask = (uint64_t(1) << boxSize) - 1;
+    std::vector<uint32_t> table(size_t(1) << boxSize);
+    uint64_t current = 0;
+    table[0] = 0;
+    for (size_t s = 1; s < table.size(); s++)
+    {
+        current ^= response[countTrailingZeros64(s)];
+        table[s ^ (s >> 1)] = (current & ~toggleMask) ? kTinyUnsolvable : uint32_t(current);
+    }
+    return table;
+}
+
+// Tables are indexed directly by shape; each is built once under its own flag
+// and published through its pointer, so lookups after the first take no lock
+std::once_flag tinyTablesBuilt[kTinyMaxCells + 1][kTinyMaxCells + 1];
+std::atomic<const std::vector<uint32_t>*> tinyTables[kTinyMaxCells + 1][kTinyMaxCells + 1];
+
+//================================================================================
+// Function: findTinyTable
+// Description: Returns the lookup table for a tiny (y, x) shape, or nullptr
+//              if it has not been generated.
+//================================================================================
+const std::vector<uint32_t>* findTinyTable(uint32_t y, uint32_t x)
+{
+    return tinyTables[y][x].load(std::memory_order_acquire);
+}
+
+//================================================================================
+// Function: tinyTable
+// Description: Returns the lookup table for a tiny (y, x) shape, generating it
+//              on first use. Tables live for the whole process.
+//================================================================================
+const std::vector<uint32_t>& tinyTable(uint32_t y, uint32_t x)
+{
+    if (const std::vector<uint32_t>* table = findTinyTable(y, x))
+        return *table;
+    std::call_once(tinyTablesBuilt[y][x], [=] {
+        tinyTables[y][x].store(new std::vector<uint32_t>(buildTinyTable(y, x)), std::memory_order_release);
+    });
+    return *findTinyTable(y, x);
+}
+
+//================================================================================
+// Function: solveTiny
+// Description: Solves a non-empty box of at most kTinyMaxCells cells with one
+//              lookup.
+//              Returns true if the state is solvable.
+//================================================================================
+bool solveTiny(const BitVector& state, uint32_t y, uint32_t x, BitVector& ans)
+{
+    const uint32_t toggles = tinyTable(y, x)[state[0]];
+    if (toggles == kTinyUnsolvable)
+        return false;
+    ans.assign(1, toggles);
+    return true;
+}
+
+//================================================================================
+// Function: structuredMasks
+// Description: Closed form of the row+column toggle operator. Toggling the set
+//              s changes cell (i, j) by R_i + C_j + s_ij, where R_i, C_j are the
+//              row and column parities of s. Summing that over a row and over
+//              a column gives, with r_i, c_j the row and column parities of
+//              the state t and T the parity of s:
+//                  x even:  R_i = r_i + T       x odd:  r_i = T for every i
+//                  y even:  C_j = c_j + T       y odd:  c_j = T for every j
+//              and the toggles are s_ij = t_ij + R_i + C_j. Hence
+//                  y, x even:  always solvable, s_ij = t_ij + r_i + c_j
+//                  y, x odd:   solvable iff all r_i and c_j are equal, s = t
+//                  mixed:      solvable iff the parities along the odd
+//                              dimension are all equal; the free row (or
+//                              column) parities only need to sum to T.
+//              Fills the R and C masks from the state parities and returns
+//              true if the state is solvable.
+//================================================================================
+bool structuredMasks(const BitVector& rowParity, const BitVector& colParity, uint32_t y, uint32_t x,
+                     BitVector& rowMask, BitVector& colMask)
+{
+    auto allEqual = [](const BitVector& v, size_t n, bool value) {
+        for (size_t k = 0; k < n; k++)
+            if (testBit(v, k) != value)
+                return false;
+        return true;
+    };
+
+    rowMask.assign(wordCount(y), 0);
+    colMask.assign(wordCount(x), 0);
+    if (x % 2 == 0 && y % 2 == 0)
+    {
+        rowMask = rowParity;
+        colMask = colParity;
+    }
+    else if (x % 2 == 1 && y % 2 == 1)
+    {
+        const bool parity = testBit(rowParity, 0);
+        if (!allEqual(rowParity, y, parity) || !allEqual(colParity, x, parity))
+            return false;
+    }
+    else if (y % 2 == 1)
+    {
+        const bool parity = testBit(colParity, 0);
+        if (!allEqual(colParity, x, parity))
+            return false;
+        rowMask = rowParity;
+        if (parity)
+        {
+            for (uint32_t i = 0; i < y; i++)
+                flipBit(rowMask, i);
+            flipBit(colMask, 0);
+        }
+    }
+    else
+    {
+        const bool parity = testBit(rowParity, 0);
+        if (!allEqual(rowParity, y, parity))
+            return false;
+        colMask = colParity;
+        if (parity)
+        {
+            for (uint32_t j = 0; j < x; j++)
+                flipBit(colMask, j);
+            flipBit(rowMask, 0);
+        }
+    }
+    return true;
+}
+
+//================================================================================
+// Function: solveStructured
+// Description: Closed-form solver (see structuredMasks), linear in the number
+//              of cells and streaming twice over the packed rows.
+//              Returns true if the state is solvable.
+//================================================================================
+bool solveStructured(const BitVector& state, uint32_t y, uint32_t x, BitVector& ans)
+{
+    const size_t rowWords = wordCount(x);
+    std::vector<uint64_t> line(rowWords);
+    BitVector rowParity(wordCount(y), 0), colParity(rowWords, 0);
+
+    // First pass: row and column parities of the state
+    for (uint32_t i = 0; i < y; i++)
+    {
+        readBits(state, size_t(i) * x, x, line.data());
+        uint64_t acc = 0;
+        for (size_t w = 0; w < rowWords; w++)
+        {
+            colParity[w] ^= line[w];
+            acc ^= line[w];
+        }
+        if (popcount64(acc) & 1)
+            flipBit(rowParity, i);
+    }
+
+    BitVector rowMask, colMask;
+    if (!structuredMasks(rowParity, colParity, y, x, rowMask, colMask))
+        return false;
+
+    // Second pass: s_ij = t_ij + R_i + C_j, one row at a time
+    ans = state;
+    ans.resize(wordCount(size_t(y) * x), 0);
+    std::vector<uint64_t> inverted(rowWords);
+    for (size_t w = 0; w < rowWords; w++)
+        inverted[w] = ~colMask[w];
+    for (uint32_t i = 0; i < y; i++)
+        xorBits(ans, size_t(i) * x, x, testBit(rowMask, i) ? inverted.data() : colMask.data());
+    return true;
+}
+
+//================================================================================
+// Struct: ToggleMasks
+// Description: Compact toggle set for the row+column operator: cell (i, j) is
+//              toggled iff rows[i] ^ cols[j] ^ (it appears in exceptions).
+//================================================================================
+using Cell = std::pair<uint32_t, uint32_t>;
+
+struct ToggleMasks
+{
+    BitVector rows, cols;
+    std::vector<Cell> exceptions;
+};
+
+//================================================================================
+// Function: solveSparse
+// Description: Solves a box given only its k locked cells, in O(k + y + x) and
+//              without touching the grid: the state parities come from the
+//              list, and the toggle set t + R + C is returned as masks with the
+//              locked cells themselves as the exceptions.
+//              Returns true if the state is solvable.
+//================================================================================
+bool solveSparse(const std::vector<Cell>& locked, uint32_t y, uint32_t x, ToggleMasks& ans)
+{
+    BitVector rowParity(wordCount(y), 0), colParity(wordCount(x), 0);
+    for (const Cell& cell : locked)
+    {
+        flipBit(rowParity, cell.first);
+        flipBit(colParity, cell.second);
+    }
+
+    if (!structuredMasks(rowParity, colParity, y, x, ans.rows, ans.cols))
+        return false;
+    ans.exceptions = locked;
+    return true;
+}
+
+//================================================================================
+// Function: solveStructured
+// Description: Same closed form as above, returning the toggle set as masks:
+//              t + R + C with the locked cells of the state as exceptions.
+//              Returns true if the state is solvable.
+//================================================================================
+bool solveStructured(const BitVector& state, uint32_t y, uint32_t x, ToggleMasks& ans)
+{
+    const size_t rowWords = wordCount(x);
+    std::vector<uint64_t> line(rowWords);
+    BitVector rowParity(wordCount(y), 0), colParity(rowWords, 0);
+    ans.exceptions.clear();
+
+    for (uint32_t i = 0; i < y; i++)
+    {
+        readBits(state, size_t(i) * x, x, line.data());
+        uint64_t acc = 0;
+        for (size_t w = 0; w < rowWords; w++)
+        {
+            colParity[w] ^= line[w];
+            acc ^= line[w];
+            for (uint64_t bits = line[w]; bits; bits &= bits - 1)
+                ans.exceptions.push_back({ i, uint32_t(w * 64 + countTrailingZeros64(bits)) });
+        }
+        if (popcount64(acc) & 1)
+            flipBit(rowParity, i);
+    }
+
+    return structuredMasks(rowParity, colParity, y, x, ans.rows, ans.cols);
+}
+
+//================================================================================
+// Function: xorToggleMasks
+// Description: XORs the cells described by masks into a packed y * x grid,
+//              a row of words at a time.
+//================================================================================
+void xorToggleMasks(BitVector& grid, const ToggleMasks& masks, uint32_t y, uint32_t x)
+{
+    std::vector<uint64_t> inverted(wordCount(x));
+    for (size_t w = 0; w < inverted.size(); w++)
+        inverted[w] = ~masks.cols[w];
+    for (uint32_t i = 0; i < y; i++)
+        xorBits(grid, size_t(i) * x, x, testBit(masks.rows, i) ? inverted.data() : masks.cols.data());
+    for (const Cell& cell : masks.exceptions)
+        flipBit(grid, size_t(cell.first) * x + cell.second);
+}
+
+//================================================================================
+// Function: expandToggleMasks
+// Description: Materializes a compact toggle set as a packed y * x toggle set.
+//================================================================================
+BitVector expandToggleMasks(const ToggleMasks& masks, uint32_t y, uint32_t x)
+{
+    BitVector ans(wordCount(size_t(y) * x), 0);
+    xorToggleMasks(ans, masks, y, x);
+    return ans;
+}
+
+//================================================================================
+// Function: toggleEffect
+// Description: Returns the cells flipped by applying a compact toggle set,
+//              again as masks, in O(y + x + exceptions). Cell (i, j) flips by
+//              P_i + Q_j + s_ij, where the row parity of the toggle set is
+//              P_i = x * rows[i] + |cols| + (exceptions in row i) and the
+//              column parity Q_j is the same with the roles swapped.
+//================================================================================
+ToggleMasks toggleEffect(const ToggleMasks& masks, uint32_t y, uint32_t x)
+{
+    size_t rowCount = 0, colCount = 0;
+    for (uint64_t w : masks.rows)
+        rowCount += popcount64(w);
+    for (uint64_t w : masks.cols)
+        colCount += popcount64(w);
+
+    ToggleMasks effect = masks;
+    for (const Cell& cell : masks.exceptions)
+    {
+        flipBit(effect.rows, cell.first);
+        flipBit(effect.cols, cell.second);
+    }
+    for (uint32_t i = 0; i < y; i++)
+        if (((x % 2) & testBit(masks.rows, i)) ^ (colCount % 2))
+            flipBit(effect.rows, i);
+    for (uint32_t j = 0; j < x; j++)
+        if (((y % 2) & testBit(masks.cols, j)) ^ (rowCount % 2))
+            flipBit(effect.cols, j);
+    return effect;
+}
+
+//================================================================================
+// Function: applyToggles
+// Description: Applies a compact toggle set to the box directly from the
+//              masks, one box row at a time, without materializing y * x
+//              toggle bits.
+//================================================================================
+void applyToggles(SecureBox& box, const ToggleMasks& masks, uint32_t y, uint32_t x)
+{
+    TraceSpan span("apply toggles");
+    std::vector<Cell> exceptions = masks.exceptions;
+    std::sort(exceptions.begin(), exceptions.end());
+
+    BitVector line(wordCount(x));
+    auto next = exceptions.begin();
+    for (uint32_t i = 0; i < y; i++)
+    {
+        const uint64_t flip = testBit(masks.rows, i) ? ~uint64_t(0) : 0;
+        for (size_t w = 0; w < line.size(); w++)
+            line[w] = masks.cols[w] ^ flip;
+        for (; next != exceptions.end() && next->first == i; ++next)
+            flipBit(line, next->second);
+
+        for (size_t w = 0; w < line.size(); w++)
+        {
+            for (uint64_t bits = line[w]; bits; bits &= bits - 1)
+            {
+                const size_t j = w * 64 + countTrailingZeros64(bits);
+                if (j < x)
+                    box.toggle(i, uint32_t(j));
+            }
+        }
+    }
+}
+
+//================================================================================
+// Class: SpeculativeBox
+// Description: A what-if copy of a box with O(1) snapshots and cheap
+//              rollback. Toggles are kept lazily: a toggle flips one row-mask
+//              bit, one column-mask bit and its own cell (which the row and
+//              column masks would otherwise flip twice), so cell (i, j) reads
+//              as cells(i, j) ^ rows[i] ^ cols[j]. Every toggle is journaled;
+//              a snapshot is the journal length, and restoring replays the
+//              newer toggles again, since each toggle is its own inverse.
+//================================================================================
+class SpeculativeBox
+{
+public:
+    explicit SpeculativeBox(const std::vector<std::vector<bool>>& state)
+        : ySize(uint32_t(state.size())), xSize(state.empty() ? 0 : uint32_t(state[0].size())),
+          stride(wordCount(xSize)), cells(size_t(ySize) * stride, 0), rows(wordCount(ySize), 0), cols(stride, 0)
+    {
+        for (uint32_t i = 0; i < ySize; i++)
+            for (uint32_t j = 0; j < xSize; j++)
+                if (state[i][j])
+                    flipBit(cells, size_t(i) * stride * 64 + j);
+    }
+
+    uint32_t height() const { return ySize; }
+    uint32_t width() const { return xSize; }
+
+    //================================================================================
+    // Method: toggle
+    // Description: Same operation as SecureBox::toggle, in O(1).
+    //================================================================================
+    void toggle(uint32_t y, uint32_t x)
+    {
+        flipBit(rows, y);
+        flipBit(cols, x);
+        flipBit(cells, size_t(y) * stride * 64 + x);
+        journal.push_back({ y, x });
+    }
+
+    //================================================================================
+    // Method: snapshot / restore
+    // Description: snapshot is O(1); restore undoes every toggle made after the
+    //              snapshot, in O(1) each.
+    //================================================================================
+    size_t snapshot() const
+    {
+        return journal.size();
+    }
+
+    void restore(size_t mark)
+    {
+        while (journal.size() > mark)
+        {
+            const Cell cell = journal.back();
+            journal.pop_back();
+            flipBit(rows, cell.first);
+            flipBit(cols, cell.second);
+            flipBit(cells, size_t(cell.first) * stride * 64 + cell.second);
+        }
+    }
+
+    //================================================================================
+    // Method: isLocked
+    // Description: Returns true if any cell is true, a row of words at a time.
+    //================================================================================
+    bool isLocked() const
+    {
+        for (uint32_t i = 0; i < ySize; i++)
+        {
+            const uint64_t flip = testBit(rows, i) ? ~uint64_t(0) : 0;
+            for (size_t w = 0; w < stride; w++)
+            {
+                uint64_t value = cells[size_t(i) * stride + w] ^ cols[w] ^ flip;
+                if (xSize - w * 64 < 64)
+                    value &= (uint64_t(1) << (xSize - w * 64)) - 1;
+                if (value)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    //================================================================================
+    // Method: packedState
+    // Description: Returns the current state in the packed row-major layout
+    //              taken by the solvers.
+    //================================================================================
+    BitVector packedState() const
+    {
+        BitVector state(wordCount(size_t(ySize) * xSize), 0);
+        std::vector<uint64_t> line(stride);
+        for (uint32_t i = 0; i < ySize; i++)
+        {
+            const uint64_t flip = testBit(rows, i) ? ~uint64_t(0) : 0;
+            for (size_t w = 0; w < stride; w++)
+                line[w] = cells[size_t(i) * stride + w] ^ cols[w] ^ flip;
+            xorBits(state, size_t(i) * xSize, xSize, line.data());
+        }
+        return state;
+    }
+
+    //================================================================================
+    // Method: getState
+    // Description: Returns a copy of the current state.
+    //================================================================================
+    std::vector<std::vector<bool>> getState() const
+    {
+        std::vector<std::vector<bool>> state(ySize, std::vector<bool>(xSize));
+        for (uint32_t i = 0; i < ySize; i++)
+            for (uint32_t j = 0; j < xSize; j++)
+                state[i][j] = testBit(cells, size_t(i) * stride * 64 + j) ^ testBit(rows, i) ^ testBit(cols, j);
+        return state;
+    }
+
+private:
+    uint32_t ySize, xSize;
+    size_t stride;
+    BitVector cells, rows, cols;
+    std::vector<Cell> journal;
+};
+
+//================================================================================
+// Class: ToggleJournal
+// Description: Append-only binary audit log of toggles. The file is an
+//              12-byte header ("SBJ1" magic, then y and x as uint32) followed
+//              by 8-byte (y, x) uint32 records. Records are buffered and written in
+//              batches. Toggles commute and cancel in pairs, so compact()
+//              can shrink any history to its net toggle parity: at most one
+//              record per distinct cell. A journal that could not be opened,
+//              or whose writes fail, drops its records and counts them.
+//              Compact a journal that is open for writing through its own
+//              compact() member: the static compact(path) replaces the file,
+//              and a writer still holding the old one would keep appending
+//              to the unlinked copy.
+//================================================================================
+class ToggleJournal
+{
+public:
+    static constexpr size_t kBatchRecords = 4096;
+
+    ToggleJournal(const std::string& path, uint32_t y, uint32_t x) : filePath(path)
+    {
+        uint32_t fileY, fileX;
+        if (std::ifstream(path, std::ios::binary).good())
+        {
+            // Only append to a journal of the same shape
+            if (!readHeader(path, fileY, fileX) || fileY != y || fileX != x)
+                return;
+
+            // Cut a torn trailing record left by a crash, so appends stay aligned
+            std::error_code error;
+            const uintmax_t size = std::filesystem::file_size(path, error);
+            if (error)
+                return;
+            const uintmax_t whole = kHeaderBytes + (size - kHeaderBytes) / kRecordBytes * kRecordBytes;
+            if (whole != size)
+            {
+                std::filesystem::resize_file(path, whole, error);
+                if (error)
+                    return;
+            }
+            out.open(path, std::ios::binary | std::ios::app);
+        }
+        else
+        {
+            out.open(path, std::ios::binary);
+            writeHeader(out, y, x);
+        }
+    }
+
+    ~ToggleJournal()
+    {
+        flush();
+    }
+
+    bool isOpen() const
+    {
+        return out.is_open() && out.good();
+    }
+
+    // Records that could not be journaled
+    size_t dropped() const
+    {
+        return droppedRecords;
+    }
+
+    //================================================================================
+    // Method: record
+    // Description: Buffers one toggle. Returns false, dropping the record, if
+    //              the journal is not open or a previous write failed.
+    //================================================================================
+    bool record(uint32_t y, uint32_t x)
+    {
+        if (!isOpen())
+        {
+            droppedRecords++;
+            return false;
+        }
+        buffer.push_back(y);
+        buffer.push_back(x);
+        if (buffer.size() >= 2 * kBatchRecords)
+            return flush();
+        return true;
+    }
+
+    //================================================================================
+    // Method: toggle
+    // Description: Toggles a box and journals the toggle. The box is toggled
+    //              even if the record is dropped.
+    //================================================================================
+    template <typename Box>
+    bool toggle(Box& box, uint32_t y, uint32_t x)
+    {
+        box.toggle(y, x);
+        return record(y, x);
+    }
+
+    //================================================================================
+    // Method: flush
+    // Description: Writes the buffered records. Returns false, counting them
+    //              as dropped, if the write fails.
+    //================================================================================
+    bool flush()
+    {
+        if (buffer.empty())
+            return true;
+        if (isOpen())
+        {
+            out.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size() * sizeof(uint32_t)));
+            out.flush();
+        }
+        const bool written = isOpen();
+        if (!written)
+            droppedRecords += buffer.size() / 2;
+        buffer.clear();
+        return written;
+    }
+
+    //================================================================================
+    // Method: read
+    // Description: Reads a whole journal. Returns false if the file is missing
+    //              or is not a journal.
+    //================================================================================
+    static bool read(const std::string& path, uint32_t& y, uint32_t& x, std::vector<Cell>& toggles)
+    {
+        if (!readHeader(path, y, x))
+            return false;
+        std::ifstream in(path, std::ios::binary);
+        in.seekg(kHeaderBytes);
+
+        toggles.clear();
+        uint32_t cell[2];
+        while (in.read(reinterpret_cast<char*>(cell), sizeof(cell)))
+            toggles.push_back({ cell[0], cell[1] });
+        return true;
+    }
+
+    //================================================================================
+    // Method: replay
+    // Description: Applies every journaled toggle to the box, in order.
+    //              Returns false, leaving the box untouched, if the journal
+    //              can't be read, its shape doesn't match the box or any
+    //              record lies outside the box.
+    //================================================================================
+    template <typename Box>
+    static bool replay(const std::string& path, Box& box, uint32_t y, uint32_t x)
+    {
+        uint32_t fileY, fileX;
+        std::vector<Cell> toggles;
+        if (!read(path, fileY, fileX, toggles) || fileY != y || fileX != x)
+            return false;
+        for (const Cell& cell : toggles)
+            if (cell.first >= y || cell.second >= x)
+                return false;
+        for (const Cell& cell : toggles)
+            box.toggle(cell.first, cell.second);
+        return true;
+    }
+
+    //================================================================================
+    // Method: compact
+    // Description: Compacts this open journal: flushes the buffered records,
+    //              rewrites the file and reopens it for append. Returns false
+    //              if the journal is not open or the rewrite fails; the
+    //              journal stays usable on the old file in the latter case.
+    //================================================================================
+    bool compact()
+    {
+        if (!isOpen() || !flush())
+            return false;
+        out.close();
+        const bool compacted = compact(filePath);
+        out.open(filePath, std::ios::binary | std::ios::app);
+        return compacted && isOpen();
+    }
+
+    //================================================================================
+    // Method: compact
+    // Description: Rewrites the journal as its net toggle parity: cells
+    //              toggled an even number of times are dropped, the rest are
+    //              kept once. The new file replaces the old one atomically.
+    //              The path must not be open in a ToggleJournal; use the
+    //              member compact() for that.
+    //================================================================================
+    static bool compact(const std::string& path)
+    {
+        uint32_t y, x;
+        std::vector<Cell> toggles;
+        if (!read(path, y, x, toggles))
+            return false;
+
+        std::sort(toggles.begin(), toggles.end());
+        std::vector<Cell> net;
+        for (size_t k = 0; k < toggles.size();)
+        {
+            size_t end = k;
+            while (end < toggles.size() && toggles[end] == toggles[k])
+                end++;
+            if ((end - k) % 2)
+                net.push_back(toggles[k]);
+            k = end;
+        }
+
+        const std::string temp = path + ".compact";
+        {
+            std::ofstream rewritten(temp, std::ios::binary | std::ios::trunc);
+            writeHeader(rewritten, y, x);
+            for (const Cell& cell : net)
+            {
+                const uint32_t record[2] = { cell.first, cell.second };
+                rewritten.write(reinterpret_cast<const char*>(record), sizeof(record));
+            }
+            if (!rewritten)
+                return false;
+        }
+        return std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    static constexpr uint32_t kMagic = 0x314A4253; // "SBJ1"
+    static constexpr std::streamoff kHeaderBytes = 12;
+    static constexpr std::streamoff kRecordBytes = 8;
+
+    std::string filePath;
+    std::ofstream out;
+    std::vector<uint32_t> buffer;
+    size_t droppedRecords = 0;
+
+    static void writeHeader(std::ofstream& file, uint32_t y, uint32_t x)
+    {
+        const uint32_t header[3] = { kMagic, y, x };
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    }
+
+    static bool readHeader(const std::string& path, uint32_t& y, uint32_t& x)
+    {
+        std::ifstream in(path, std::ios::binary);
+        uint32_t header[3];
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kMagic)
+            return false;
+        y = header[1];
+        x = header[2];
+        return true;
+    }
+};
+
+//================================================================================
+// Function: solveCachedInverse
+// Description: Solves with the shape's cached solve map: one check product and
+//              one solution product. Returns true if the state is solvable.
+//================================================================================
+bool solveCachedInverse(const SolveMap& map, const BitVector& state, BitVector& ans)
+{
+    const BitVector syndrome = map.checks.multiply(state);
+    if (std::any_of(syndrome.begin(), syndrome.end(), [](uint64_t w) { return w != 0; }))
+        return false;
+    ans = map.solution.multiply(state);
+    return true;
+}
+
+bool solveCachedInverse(const BitVector& state, uint32_t y, uint32_t x, BitVector& ans)
+{
+    return solveCachedInverse(cachedSolveMap(y, x), state, ans);
+}
+
+//================================================================================
+// Backend planner
+// Description: Every backend solves the same problem; they differ in setup
+//              cost, per-solve cost and memory. The planner estimates all
+//              three from the shape and the workload and picks the cheapest
+//              backend that fits in memory.
+//================================================================================
+enum class Backend
+{
+    TinyTable,
+    Structured,
+    Compiled,
+    BitSliced,
+    CachedInverse,
+    Symmetric,
+    GaussJordan,
+};
+
+const char* backendName(Backend backend)
+{
+    switch (backend)
+    {
+    case Backend::TinyTable: return "tiny-table";
+    case Backend::Structured: return "structured";
+    case Backend::Compiled: return "compiled";
+    case Backend::BitSliced: return "bit-sliced";
+    case Backend::CachedInverse: return "cached-inverse";
+    case Backend::Symmetric: return "symmetric";
+    case Backend::GaussJordan: return "gauss-jordan";
+    }
+    return "unknown";
+}
+
+//================================================================================
+// Struct: CostModel
+// Description: Host-dependent unit costs in nanoseconds, used by the planner.
+//              The defaults are rough figures for a current x86-64 core; a
+//              profile written by calibrateCostModel replaces them.
+//================================================================================
+struct CostModel
+{
+    double wordOp = 0.3;          // one 64-bit XOR/AND in a streaming loop
+    double bitOp = 1.0;           // one single-bit read or write
+    double intOp = 0.5;           // one int XOR in the reference elimination
+    double lookup = 20.0;         // one random table lookup
+    double allocation = 40.0;     // one heap allocation of a working vector
+    double matVecScale = 1.0;     // measured / modelled cost of a solve-map product
+    double structuredScale = 1.0; // measured / modelled cost of the structured solver
+    double pairOp = 1.0;          // one output word of the XOR compiler's pair search
+};
+
+//================================================================================
+// Function: compilePairWords
+// Description: Work of XorProgram::compile in output words compared: every
+//              extraction rescans all pairs of active signals, and the active
+//              set grows from the n inputs by one signal per extraction.
+//              Uses the XOR count as the number of extractions, which
+//              overestimates slightly since the final chaining is cheap.
+//================================================================================
+double compilePairWords(double n, double xors, double outputs)
+{
+    const double active = n + xors / 2;
+    return xors * active * active / 2 * std::ceil(outputs / 64);
+}
+
+// Profile read at startup if present, written by --calibrate
+const char* const kCostProfilePath = "secure_box.profile";
+
+//================================================================================
+// Function: readCostProfile / writeCostProfile
+// Description: The profile is a small text file of "name value" lines. Unknown
+//              names are ignored so older binaries can read newer profiles.
+//================================================================================
+bool readCostProfile(const std::string& path, CostModel& model)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    std::string name;
+    double value;
+    while (in >> name >> value)
+    {
+        if (name == "wordOp") model.wordOp = value;
+        else if (name == "bitOp") model.bitOp = value;
+        else if (name == "intOp") model.intOp = value;
+        else if (name == "lookup") model.lookup = value;
+        else if (name == "allocation") model.allocation = value;
+        else if (name == "matVecScale") model.matVecScale = value;
+        else if (name == "structuredScale") model.structuredScale = value;
+        else if (name == "pairOp") model.pairOp = value;
+    }
+    return true;
+}
+
+bool writeCostProfile(const std::string& path, const CostModel& model)
+{
+    std::ofstream out(path);
+    out << "wordOp " << model.wordOp << "\n"
+        << "bitOp " << model.bitOp << "\n"
+        << "intOp " << model.intOp << "\n"
+        << "lookup " << model.lookup << "\n"
+        << "allocation " << model.allocation << "\n"
+        << "matVecScale " << model.matVecScale << "\n"
+        << "structuredScale " << model.structuredScale << "\n"
+        << "pairOp " << model.pairOp << "\n";
+    return bool(out);
+}
+
+CostModel& costModel()
+{
+    static CostModel model = [] {
+        CostModel loaded;
+        readCostProfile(kCostProfilePath, loaded);
+        return loaded;
+    }();
+    return model;
+}
+
+// Largest shape the planner will compile into an XOR program
+constexpr size_t kCompileMaxCells = 144;
+
+//================================================================================
+// Struct: PlanRequest / Plan
+// Description: Planner input (shape and workload) and decision. costNs is the
+//              estimated cost per box including amortized setup. Setup work
+//              (tables, maps, programs) that is not cached yet is amortized
+//              over the shape's solves seen so far, so a one-off request is
+//              not charged as if it were the first of millions.
+//================================================================================
+struct PlanRequest
+{
+    uint32_t y = 0, x = 0;
+    size_t batch = 1;
+    size_t solves = 0;      // solves of this shape so far, this batch included; 0: just this batch
+    size_t memoryBytes = 0; // 0: physical memory of the host
+    unsigned threads = 0;   // 0: hardware concurrency
+};
+
+struct Plan
+{
+    Backend backend = Backend::Structured;
+    double costNs = 0;
+    size_t memoryBytes = 0;
+};
+
+//================================================================================
+// Instrumentation
+// Description: Optional hooks for observing the solver. Unset hooks cost one
+//              branch.
+//================================================================================
+struct Instrumentation
+{
+    std::function<void(const PlanRequest&, const Plan&)> onPlan;
+};
+
+Instrumentation& instrumentation()
+{
+    static Instrumentation hooks;
+    return hooks;
+}
+
+//================================================================================
+// Function: physicalMemoryBytes / hostThreads
+// Description: Physical memory of the host (4 GiB if it can't be queried)
+//              and its hardware concurrency. Both are queried once.
+//================================================================================
+size_t physicalMemoryBytes()
+{
+    static const size_t bytes = [] {
+#ifdef _SC_PHYS_PAGES
+        const long pages = sysconf(_SC_PHYS_PAGES), pageSize = sysconf(_SC_PAGE_SIZE);
+        if (pages > 0 && pageSize > 0)
+            return size_t(pages) * size_t(pageSize);
+#endif
+        return size_t(4) << 30;
+    }();
+    return bytes;
+}
+
+unsigned hostThreads()
+{
+    static const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    return threads;
+}
+
+//================================================================================
+// Function: planSolve
+// Description: Estimates every backend and returns the cheapest feasible one.
+//              Memory is budgeted per thread, since a batch runs one solve per
+//              thread and each keeps its own working set. Even x even shapes
+//              are invertible; other parities add consistency checks to the
+//              compiled program.
+//================================================================================
+Plan planSolve(const PlanRequest& request)
+{
+    const CostModel& model = costModel();
+    const double n = double(request.y) * request.x;
+    const double words = std::ceil(n / 64);
+    const double log2n = std::max(1.0, std::log2(n));
+    const bool invertible = request.y % 2 == 0 && request.x % 2 == 0;
+    const double horizon = double(std::max(request.batch, request.solves));
+
+    const unsigned threads = request.threads ? request.threads : hostThreads();
+    const size_t memory = request.memoryBytes ? request.memoryBytes : physicalMemoryBytes();
+    const double budget = double(memory) / threads;
+
+    // XOR count of the compiled program: measured if compiled, else Paar's usual n^2 / log n
+    const XorProgram* program = findCompiledProgram(request.y, request.x);
+    const double outputs = n + (invertible ? 0 : double(request.y) + request.x);
+    const double xors = program ? double(program->xorCount()) : outputs * n / (4 * log2n);
+    const double mapSetup = findSolveMap(request.y, request.x) ? 0 : 2 * n * n * words * model.wordOp;
+    const double compileSetup = program ? 0 : mapSetup + compilePairWords(n, xors, outputs) * model.pairOp;
+    const bool tiny = n >= 1 && n <= kTinyMaxCells;
+    const double tinySetup = tiny && !findTinyTable(request.y, request.x) ? std::exp2(n) * model.wordOp + mapSetup : 0;
+
+    struct Candidate
+    {
+        Backend backend;
+        bool feasible;
+        double costNs;
+        double memoryBytes;
+    };
+    const Candidate candidates[] = {
+        { Backend::TinyTable, tiny,
+          model.lookup + model.allocation + tinySetup / horizon, 4 * std::exp2(std::min(n, 63.0)) },
+        { Backend::Structured, true,
+          ((2 * words + 2 * request.y * std::ceil(request.x / 64.0)) * model.wordOp + (double(request.y) + request.x) * model.bitOp)
+                  * model.structuredScale
+              + 6 * model.allocation,
+          n / 8 + double(request.y) + request.x },
+        { Backend::Compiled, n <= kCompileMaxCells,
+          (xors + 2 * n) * model.bitOp + model.allocation + compileSetup / horizon, n * n / 4 + 8 * xors },
+        { Backend::BitSliced, n <= kCompileMaxCells && request.batch >= Slice64::kBoxes,
+          (xors * Slice512::kLanes + 2 * words * 64) * model.wordOp / Slice512::kBoxes + n / 64 * model.wordOp
+              + model.allocation + compileSetup / horizon,
+          n * n / 4 + 8 * xors + 2 * 64 * n * Slice512::kLanes },
+        { Backend::CachedInverse, true,
+          2 * n * words * model.wordOp * model.matVecScale + 2 * model.allocation + mapSetup / horizon, n * n / 4 + 3 * n * words * 8 },
+        { Backend::Symmetric, true,
+          n * n * words / 3 * model.wordOp + n * n * model.bitOp + 8 * model.allocation, n * words * 4 },
+        { Backend::GaussJordan, true,
+          n * n * n / 2 * model.intOp + (n + 3) * model.allocation, 4 * n * (n + 1) },
+    };
+
+    Plan plan;
+    double best = INFINITY;
+    for (const Candidate& candidate : candidates)
+    {
+        if (!candidate.feasible || candidate.memoryBytes > budget || candidate.costNs >= best)
+            continue;
+        best = candidate.costNs;
+        plan.backend = candidate.backend;
+        plan.costNs = candidate.costNs;
+        plan.memoryBytes = size_t(candidate.memoryBytes);
+    }
+
+    if (instrumentation().onPlan)
+        instrumentation().onPlan(request, plan);
+    return plan;
+}
+
+//================================================================================
+// Function: solveWithBackend
+// Description: Solves a single packed state with the given backend. The
+//              bit-sliced backend is batch-only and falls back to the compiled
+//              program for a single state.
+//              Returns true if the state is solvable.
+//================================================================================
+bool solveWithBackend(Backend backend, const BitVector& state, uint32_t y, uint32_t x, BitVector& ans)
+{
+    TraceSpan span(backendName(backend));
+    switch (backend)
+    {
+    case Backend::TinyTable: return solveTiny(state, y, x, ans);
+    case Backend::Structured: return solveStructured(state, y, x, ans);
+    case Backend::Compiled:
+    case Backend::BitSliced: return solveCompiled(compileShape(y, x), state, ans);
+    case Backend::CachedInverse: return solveCachedInverse(state, y, x, ans);
+    case Backend::Symmetric: return solveSymmetric(state, y, x, ans);
+    case Backend::GaussJordan: return solveGaussJordan(state, y, x, ans);
+    }
+    return false;
+}
+
+//================================================================================
+// Function: cachedPlan
+// Description: Planning for the solver front ends. Each thread counts the
+//              solves it has seen per shape and keeps the last plan per batch
+//              size bucket (power of two). A plan is redone each time the
+//              count doubles, so setup that has become worth paying for (or
+//              has been cached meanwhile) is picked up, and a steady stream of
+//              requests costs one lookup instead of a full re-plan.
+//================================================================================
+Plan cachedPlan(uint32_t y, uint32_t x, size_t batch)
+{
+    struct ShapePlans
+    {
+        size_t solves = 0;
+        size_t replanAt[65] = {};
+        Plan plans[65];
+    };
+    thread_local std::map<std::pair<uint32_t, uint32_t>, ShapePlans> shapes;
+    thread_local std::pair<uint32_t, uint32_t> lastShape;
+    thread_local ShapePlans* last = nullptr;
+
+    if (!last || lastShape != std::make_pair(y, x))
+    {
+        lastShape = { y, x };
+        last = &shapes[lastShape];
+    }
+
+    ShapePlans& shape = *last;
+    shape.solves += batch;
+    const unsigned bucket = batch ? 64 - __builtin_clzll(batch) : 0;
+    if (shape.solves >= shape.replanAt[bucket])
+    {
+        PlanRequest request;
+        request.y = y;
+        request.x = x;
+        request.batch = batch;
+        request.solves = shape.solves;
+        shape.plans[bucket] = planSolve(request);
+        shape.replanAt[bucket] = 2 * std::max<size_t>(shape.solves, 1);
+    }
+    return shape.plans[bucket];
+}
+
+//================================================================================
+// Function: nsPerCall
+// Description: Runs f repeatedly for at least 20 ms and returns the average
+//              time per call in nanoseconds.
+//================================================================================
+template <typename F>
+double nsPerCall(F&& f)
+{
+    using Clock = std::chrono::steady_clock;
+    size_t calls = 0;
+    const Clock::time_point start = Clock::now();
+    Clock::duration elapsed;
+    do
+    {
+        for (int k = 0; k < 16; k++)
+            f();
+        calls += 16;
+        elapsed = Clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(20));
+    return std::chrono::duration<double, std::nano>(elapsed).count() / calls;
+}
+
+//================================================================================
+// Function: calibrateCostModel
+// Description: Fits the cost model to this host with short micro-benchmarks:
+//              the packed row XOR kernel, the int row XOR of the reference
+//              elimination, table lookups, allocations, toggle application
+//              (single-bit work), a solve-map product, a structured solve and
+//              an XOR program compile. The solve-map product and structured
+//              solve are stored as corrections to their modelled cost.
+//================================================================================
+CostModel calibrateCostModel()
+{
+    CostModel model;
+    std::mt19937_64 rng(1);
+    volatile uint64_t sink = 0;
+
+    // Row XOR kernel on rows larger than L1, as in a large elimination
+    BitMatrix rows(2, 64 * 4096);
+    for (size_t w = 0; w < rows.words(); w++)
+        rows.row(1)[w] = rng();
+    model.wordOp = nsPerCall([&] { rows.xorRow(0, 1); }) / rows.words();
+
+    std::vector<int> a(4096, 1), b(4096, 0);
+    model.intOp = nsPerCall([&] {
+        for (size_t c = 0; c < a.size(); c++)
+            b[c] ^= a[c];
+    }) / a.size();
+
+    std::vector<uint32_t> table(size_t(1) << 20);
+    for (uint32_t& entry : table)
+        entry = uint32_t(rng());
+    uint64_t index = 0;
+    model.lookup = nsPerCall([&] {
+        index = (index * 6364136223846793005ull + 1442695040888963407ull);
+        sink = sink + table[index >> 44];
+    });
+
+    model.allocation = nsPerCall([&] {
+        BitVector v(16);
+        sink = sink + v.size();
+    });
+
+    // Each toggle on a SecureBox flips y + x single bits
+    const uint32_t side = 64;
+    SecureBox box(side, side);
+    uint32_t cell = 0;
+    model.bitOp = nsPerCall([&] {
+        cell = (cell + 37) % (side * side);
+        box.toggle(cell / side, cell % side);
+    }) / (2 * side + 1);
+
+    const uint32_t shape = 16;
+    const size_t boxSize = size_t(shape) * shape, words = wordCount(boxSize);
+    BitVector state(words), ans;
+    for (uint64_t& w : state)
+        w = rng();
+    const SolveMap& map = cachedSolveMap(shape, shape);
+    const double matVec = nsPerCall([&] { sink = sink + map.solution.multiply(state)[0]; });
+    model.matVecScale = matVec / (boxSize * words * model.wordOp + model.allocation);
+
+    const uint32_t large = 512;
+    BitVector largeState(wordCount(size_t(large) * large));
+    for (uint64_t& w : largeState)
+        w = rng();
+    const double structured = nsPerCall([&] { solveStructured(largeState, large, large, ans); });
+    const double modelled = (2 * double(largeState.size()) + 2 * large * wordCount(large)) * model.wordOp
+                          + 2 * large * model.bitOp;
+    model.structuredScale = std::max(0.01, (structured - 6 * model.allocation) / modelled);
+
+    // Compile an uncached program; a 6x6 compile takes about a millisecond
+    const uint32_t small = 6;
+    const SolveMap& smallMap = cachedSolveMap(small, small);
+    const double smallCells = double(small) * small;
+    const double compile = nsPerCall([&] { sink = sink + compileSolveMap(smallMap).xorCount(); });
+    const double xors = double(compileSolveMap(smallMap).xorCount());
+    model.pairOp = compile / compilePairWords(smallCells, xors, smallCells);
+
+    return model;
+}
+
+//================================================================================
+// Latency histograms
+// Description: Per-request solve latency of the solveState and solveStates
+//              front ends, in log-linear (HDR-style) histograms keyed by
+//              shape class and backend. Values below 128 ns have exact
+//              buckets; above that each power of two is split into 64
+//              buckets, so any recorded value is off by less than 1.6%.
+//              Each thread records into its own histograms without locks;
+//              latencySnapshot merges every thread's histograms on read,
+//              including those of threads that have exited.
+//================================================================================
+constexpr size_t kLatencyLinearBuckets = 128;
+constexpr size_t kLatencySubBuckets = 64;
+constexpr size_t kLatencyBuckets = (64 - 6) * kLatencySubBuckets + kLatencySubBuckets;
+
+inline size_t latencyBucket(uint64_t ns)
+{
+    if (ns < kLatencyLinearBuckets)
+        return size_t(ns);
+    const unsigned shift = 63 - __builtin_clzll(ns) - 6;
+    return shift * kLatencySubBuckets + size_t(ns >> shift);
+}
+
+// Highest value that falls into the bucket
+inline uint64_t latencyBucketValue(size_t bucket)
+{
+    if (bucket < kLatencyLinearBuckets)
+        return bucket;
+    const unsigned shift = unsigned(bucket / kLatencySubBuckets - 1);
+    const uint64_t mantissa = bucket - shift * kLatencySubBuckets;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+//================================================================================
+// Function: shapeClass
+// Description: Shapes are grouped by cell count rounded up to a power of two;
+//              returns the exponent.
+//================================================================================
+inline uint32_t shapeClass(uint32_t y, uint32_t x)
+{
+    const uint64_t cells = uint64_t(y) * x;
+    return cells <= 1 ? 0 : 64 - __builtin_clzll(cells - 1);
+}
+
+struct LatencyKey
+{
+    uint32_t shapeClass;
+    Backend backend;
+
+    bool operator<(const LatencyKey& other) const
+    {
+        return shapeClass != other.shapeClass ? shapeClass < other.shapeClass : backend < other.backend;
+    }
+};
+
+//================================================================================
+// Class: LatencyHistogram
+// Description: Mergeable histogram snapshot with percentile queries.
+//================================================================================
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : counts(kLatencyBuckets, 0) {}
+
+    void add(size_t bucket, uint64_t count)
+    {
+        counts[bucket] += count;
+        total += count;
+    }
+
+    uint64_t count() const { return total; }
+
+    //================================================================================
+    // Method: percentile
+    // Description: Smallest bucket value at or below which a fraction q of
+    //              the recorded values fall, or 0 if nothing was recorded.
+    //================================================================================
+    uint64_t percentile(double q) const
+    {
+        if (!total)
+            return 0;
+        const uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(q * double(total))));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < kLatencyBuckets; b++)
+        {
+            seen += counts[b];
+            if (seen >= rank)
+                return latencyBucketValue(b);
+        }
+        return latencyBucketValue(kLatencyBuckets - 1);
+    }
+
+    uint64_t max() const { return percentile(1.0); }
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+};
+
+//================================================================================
+// Struct: ThreadLatency
+// Description: One thread's histograms. Only the owning thread records;
+//              counts are atomics written with relaxed stores so a reader can
+//              merge concurrently, and the lock is taken only to add a key
+//              and to read.
+//================================================================================
+struct ThreadLatency
+{
+    using Counts = std::unique_ptr<std::atomic<uint64_t>[]>;
+
+    std::mutex lock;
+    std::map<LatencyKey, Counts> histograms;
+
+    void record(const LatencyKey& key, uint64_t ns, uint64_t count)
+    {
+        auto found = histograms.find(key);
+        if (found == histograms.end())
+        {
+            Counts counts(new std::atomic<uint64_t>[kLatencyBuckets]);
+            for (size_t b = 0; b < kLatencyBuckets; b++)
+                counts[b].store(0, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> guard(lock);
+            found = histograms.emplace(key, std::move(counts)).first;
+        }
+        std::atomic<uint64_t>& bucket = found->second[latencyBucket(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+};
+
+std::mutex latencyRegistryLock;
+std::vector<std::shared_ptr<ThreadLatency>> latencyRegistry;
+
+ThreadLatency& threadLatency()
+{
+    thread_local std::shared_ptr<ThreadLatency> mine = [] {
+        auto latency = std::make_shared<ThreadLatency>();
+        std::lock_guard<std::mutex> guard(latencyRegistryLock);
+        latencyRegistry.push_back(latency);
+        return latency;
+    }();
+    return *mine;
+}
+
+//================================================================================
+// Function: recordLatency
+// Description: Records count requests that each took ns nanoseconds.
+//================================================================================
+void recordLatency(uint32_t y, uint32_t x, Backend backend, uint64_t ns, uint64_t count = 1)
+{
+    threadLatency().record(LatencyKey{ shapeClass(y, x), backend }, ns, count);
+}
+
+//================================================================================
+// Function: latencySnapshot
+// Description: Merges every thread's histograms into one per key.
+//================================================================================
+std::map<LatencyKey, LatencyHistogram> latencySnapshot()
+{
+    std::map<LatencyKey, LatencyHistogram> merged;
+    std::lock_guard<std::mutex> registryGuard(latencyRegistryLock);
+    for (const std::shared_ptr<ThreadLatency>& latency : latencyRegistry)
+    {
+        std::lock_guard<std::mutex> guard(latency->lock);
+        for (const auto& entry : latency->histograms)
+        {
+            LatencyHistogram& histogram = merged[entry.first];
+            for (size_t b = 0; b < kLatencyBuckets; b++)
+                if (const uint64_t count = entry.second[b].load(std::memory_order_relaxed))
+                    histogram.add(b, count);
+        }
+    }
+    return merged;
+}
+
+//================================================================================
+// Function: dumpLatency
+// Description: One line per shape class and backend: request count and
+//              p50 / p90 / p99 / p99.9 / max latency in nanoseconds.
+//================================================================================
+void dumpLatency(std::ostream& out)
+{
+    for (const auto& entry : latencySnapshot())
     {
-        for (int j = 0; j < box.getState()[i].size(); j++)
-        {
-            std::cout << box.getState()[i][j] << " ";
-        }
-        std::cout << std::endl;
+        const LatencyHistogram& histogram = entry.second;
+        out << "cells<=" << (uint64_t(1) << entry.first.shapeClass) << ' ' << backendName(entry.first.backend)
+            << ": count=" << histogram.count() << " p50=" << histogram.percentile(0.5)
+            << " p90=" << histogram.percentile(0.9) << " p99=" << histogram.percentile(0.99)
+            << " p999=" << histogram.percentile(0.999) << " max=" << histogram.max() << " ns\n";
     }
 }
 
 //================================================================================
-// Function: openBox
-// Description: Your task is to implement this function to unlock the SecureBox.
-//              Use only the public methods of SecureBox (toggle, getState, isLocked).
-//              You must determine the correct sequence of toggle operations to make
-//              all values in the box 'false'. The function should return false if
-//              the box is successfully unlocked, or true if any cell remains locked.
+// Function: solveState
+// Description: Solver front end: finds toggles that turn the packed state
+//              all-false, using the backend chosen by cachedPlan, and records
+//              the request's latency (planning included).
+//              Returns true if the state is solvable.
 //================================================================================
+bool solveState(const BitVector& state, uint32_t y, uint32_t x, BitVector& ans)
+{
+    const uint64_t start = traceNowNs();
+    const Backend backend = cachedPlan(y, x, 1).backend;
+    const bool solvable = solveWithBackend(backend, state, y, x, ans);
+    recordLatency(y, x, backend, traceNowNs() - start);
+    return solvable;
+}
 
-bool openBox(uint32_t y, uint32_t x)
+//================================================================================
+// Function: solveStates
+// Description: Batch front end for many same-shape states. The planner sees
+//              the batch size, so large batches of small shapes go to the
+//              bit-sliced solver and everything else is solved box by box.
+//              Box-by-box latency is recorded per box; a bit-sliced box is
+//              only answered when the whole batch is, so each records the
+//              batch time.
+//================================================================================
+void solveStates(uint32_t y, uint32_t x, const std::vector<BitVector>& states,
+                 std::vector<BitVector>& answers, std::vector<bool>& solvable)
 {
-    SecureBox box(y, x);
+    uint64_t start = traceNowNs();
+    const Backend backend = cachedPlan(y, x, states.size()).backend;
 
-    print(box);
+    if (backend == Backend::BitSliced)
+    {
+        solveBatch(y, x, states, answers, solvable);
+        recordLatency(y, x, backend, traceNowNs() - start, states.size());
+        return;
+    }
 
-    // Initial matrix state from the box
-    const auto state = box.getState();
-    const int boxSize = y * x;
+    answers.resize(states.size());
+    solvable.resize(states.size());
+    for (size_t b = 0; b < states.size(); b++)
+    {
+        solvable[b] = solveWithBackend(backend, states[b], y, x, answers[b]);
+        const uint64_t end = traceNowNs();
+        recordLatency(y, x, backend, end - start);
+        start = end;
+    }
+}
 
-    // Matrix of valid configurations for the box matrix of size boxSize...boxSize + 1
-    std::vector<std::vector<int>> matrix(boxSize, std::vector<int>(boxSize + 1, 0));
+#if defined(__unix__) || defined(__APPLE__)
+//================================================================================
+// Class: SharedRegion
+// Description: Anonymous shared mapping, created before fork so that the
+//              parent and every worker see the same pages.
+//================================================================================
+class SharedRegion
+{
+public:
+    explicit SharedRegion(size_t bytes) : size(bytes)
+    {
+        void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        base = mapped == MAP_FAILED ? nullptr : static_cast<uint8_t*>(mapped);
+    }
 
-    /*
-    * Formula: sum(a,b) = (i==a | j==b),
-    * where valid configurations are equal to L(a,b) = XOR state(i,j);
-    */
+    ~SharedRegion()
+    {
+        if (base)
+            munmap(base, size);
+    }
 
-    // Constructing the matrix and storing the initial box matrix
-    for (uint32_t i = 0; i < y; i++)
+    SharedRegion(const SharedRegion&) = delete;
+    SharedRegion& operator=(const SharedRegion&) = delete;
+
+    uint8_t* data() const { return base; }
+
+private:
+    uint8_t* base;
+    size_t size;
+};
+
+//================================================================================
+// Function: solveSharded
+// Description: Solves a large same-shape batch in forked worker processes.
+//              States and answers live in one shared mapping laid out as
+//                  next chunk | work list | slot status | states | answers
+//              Workers claim chunks of the work list with an atomic counter,
+//              solve them and write answers in place, so nothing is
+//              serialized. The backend is planned and its tables built
+//              before forking, and workers solve with those directly: the
+//              caller may be multi-threaded, and a lock held by another
+//              thread at fork time would never be released in the child.
+//              Workers record no latency; the parent records the batch.
+//
+//              A worker still running at the deadline is killed. Slots left
+//              unfinished by a worker that crashed or was killed are put back
+//              on the work list for one more round of fresh workers; slots
+//              that fail again are reported unsolvable. A zero deadline means
+//              ten times the planner's estimate, and at least one second.
+//              Returns true if every box was processed.
+//================================================================================
+bool solveSharded(uint32_t y, uint32_t x, const std::vector<BitVector>& states,
+                  std::vector<BitVector>& answers, std::vector<bool>& solvable, unsigned workers,
+                  std::chrono::milliseconds deadline = std::chrono::milliseconds(0))
+{
+    enum SlotStatus : uint8_t { Pending, Solvable, Unsolvable };
+    const uint64_t start = traceNowNs();
+    const size_t count = states.size();
+    const size_t stride = wordCount(size_t(y) * x);
+    const size_t chunk = Slice512::kBoxes;
+    workers = std::max(1u, workers);
+
+    const size_t listOffset = sizeof(std::atomic<uint64_t>);
+    const size_t statusOffset = listOffset + count * sizeof(uint64_t);
+    const size_t statesOffset = (statusOffset + count + 63) / 64 * 64;
+    const size_t answersOffset = statesOffset + count * stride * sizeof(uint64_t);
+    SharedRegion region(answersOffset + count * stride * sizeof(uint64_t));
+    if (!region.data())
+        return false;
+
+    uint8_t* base = region.data();
+    auto* nextChunk = new (base) std::atomic<uint64_t>(0);
+    uint64_t* workList = reinterpret_cast<uint64_t*>(base + listOffset);
+    auto* status = reinterpret_cast<std::atomic<uint8_t>*>(base + statusOffset);
+    uint64_t* sharedStates = reinterpret_cast<uint64_t*>(base + statesOffset);
+    uint64_t* sharedAnswers = reinterpret_cast<uint64_t*>(base + answersOffset);
+
+    for (size_t b = 0; b < count; b++)
     {
-        for (uint32_t j = 0; j < x; j++)
-        {
+        new (&status[b]) std::atomic<uint8_t>(Pending);
+        std::copy(states[b].begin(), states[b].begin() + stride, sharedStates + b * stride);
+    }
 
-            // Index for the matrix
-            int p = i * x + j;
+    // Plan and build the shape's tables here, so every worker inherits them copy-on-write
+    PlanRequest request;
+    request.y = y;
+    request.x = x;
+    request.batch = std::min(count, chunk);
+    request.solves = count;
+    const Plan plan = planSolve(request);
+    const XorProgram* program = nullptr;
+    const SolveMap* map = nullptr;
+    switch (plan.backend)
+    {
+    case Backend::TinyTable: tinyTable(y, x); break;
+    case Backend::Compiled:
+    case Backend::BitSliced: program = &compileShape(y, x); break;
+    case Backend::CachedInverse: map = &cachedSolveMap(y, x); break;
+    default: break;
+    }
 
-            // Insert the initial box matrix into the system matrix
-            matrix[p][boxSize] = state[i][j] ? 1 : 0;
+    if (deadline.count() == 0)
+    {
+        const double estimateMs = plan.costNs * double(count) / workers / 1e6;
+        deadline = std::chrono::milliseconds(std::max<int64_t>(1000, int64_t(10 * estimateMs)));
+    }
 
-            // Marking the effects of toggle as valid configurations for column cells j
-            for (uint32_t a = 0; a < y; a++)
+    for (int round = 0; round < 2; round++)
+    {
+        size_t pending = 0;
+        for (size_t b = 0; b < count; b++)
+            if (status[b].load() == Pending)
+                workList[pending++] = b;
+        if (pending == 0)
+            break;
+        nextChunk->store(0);
+
+        std::vector<pid_t> children;
+        for (unsigned w = 0; w < workers; w++)
+        {
+            const pid_t pid = fork();
+            if (pid != 0)
             {
-                int q = a * x + j;
-                matrix[p][q] = 1;
+                if (pid > 0)
+                    children.push_back(pid);
+                continue;
             }
-            // Marking the effects of toggle as valid configurations for row cells i
-            for (uint32_t b = 0; b < x; b++)
+
+            // Worker: claim chunks until the work list is exhausted
+            std::vector<BitVector> group, groupAnswers;
+            std::vector<bool> groupSolvable;
+            for (;;)
             {
-                int q = i * x + b;
-                matrix[p][q] = 1;
+                const size_t first = nextChunk->fetch_add(1) * chunk;
+                if (first >= pending)
+                    break;
+                const size_t last = std::min(pending, first + chunk);
+
+                group.resize(last - first);
+                for (size_t k = first; k < last; k++)
+                {
+                    const uint64_t* state = sharedStates + workList[k] * stride;
+                    group[k - first].assign(state, state + stride);
+                }
+
+                if (plan.backend == Backend::BitSliced)
+                {
+                    solveBatch(*program, group, groupAnswers, groupSolvable);
+                }
+                else
+                {
+                    groupAnswers.resize(group.size());
+                    groupSolvable.resize(group.size());
+                    for (size_t k = 0; k < group.size(); k++)
+                    {
+                        if (program)
+                            groupSolvable[k] = solveCompiled(*program, group[k], groupAnswers[k]);
+                        else if (map)
+                            groupSolvable[k] = solveCachedInverse(*map, group[k], groupAnswers[k]);
+                        else
+                            groupSolvable[k] = solveWithBackend(plan.backend, group[k], y, x, groupAnswers[k]);
+                    }
+                }
+
+                for (size_t k = first; k < last; k++)
+                {
+                    const BitVector& ans = groupAnswers[k - first];
+                    std::copy(ans.begin(), ans.begin() + std::min(ans.size(), stride), sharedAnswers + workList[k] * stride);
+                    status[workList[k]].store(groupSolvable[k - first] ? Solvable : Unsolvable, std::memory_order_release);
+                }
+            }
+            _exit(0);
+        }
+
+        // Reap workers, killing any still running at the deadline
+        const auto killAt = std::chrono::steady_clock::now() + deadline;
+        while (!children.empty())
+        {
+            const bool expired = std::chrono::steady_clock::now() >= killAt;
+            for (size_t c = 0; c < children.size();)
+            {
+                if (expired)
+                    kill(children[c], SIGKILL);
+                const pid_t reaped = waitpid(children[c], nullptr, expired ? 0 : WNOHANG);
+                if (reaped == children[c] || (reaped < 0 && errno != EINTR))
+                {
+                    children[c] = children.back();
+                    children.pop_back();
+                }
+                else
+                {
+                    c++;
+                }
             }
+            if (!children.empty() && !expired)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
     }
 
-    // Solving using Gauss-Jordan elimination modulo two.
+    bool complete = true;
+    answers.resize(count);
+    solvable.resize(count);
+    for (size_t b = 0; b < count; b++)
+    {
+        const uint8_t result = status[b].load(std::memory_order_acquire);
+        complete &= result != Pending;
+        solvable[b] = result == Solvable;
+        answers[b].assign(sharedAnswers + b * stride, sharedAnswers + (b + 1) * stride);
+    }
+    if (count)
+        recordLatency(y, x, plan.backend, traceNowNs() - start, count);
+    return complete;
+}
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+//================================================================================
+// Class: Transport
+// Description: One end of a reliable, ordered byte channel between the
+//              coordinator and a worker process. Both ends are created before
+//              fork; each process keeps its own end and closes the other.
+//================================================================================
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+    virtual bool send(const void* data, size_t bytes) = 0;
+    virtual bool receive(void* data, size_t bytes) = 0;
+    virtual void close() = 0;
+};
+
+//================================================================================
+// Class: SocketTransport
+// Description: Transport over one end of a local socket pair, standing in for
+//              a cluster interconnect. Sending to a peer that has exited
+//              fails with EPIPE instead of raising SIGPIPE, so a dead worker
+//              shows up as a failed send rather than killing the coordinator.
+//================================================================================
+class SocketTransport : public Transport
+{
+public:
+    explicit SocketTransport(int descriptor) : fd(descriptor)
+    {
+#ifdef SO_NOSIGPIPE
+        const int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
 
-    int row = 0;
-    std::vector<int> index(boxSize, -1);
-    for (int col = 0; col < boxSize && row < boxSize; col++)
+    ~SocketTransport() override
     {
-        int pivot = -1;
-        // Finding a 1 in the column to use as a pivot value.
-        for (int r = row; r < boxSize; r++)
+        close();
+    }
+
+    bool send(const void* data, size_t bytes) override
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        while (bytes > 0)
         {
-            if (matrix[r][col] == 1)
-            {
-                pivot = r;
-                break;
-            }
+#ifdef MSG_NOSIGNAL
+            const ssize_t sent = ::send(fd, p, bytes, MSG_NOSIGNAL);
+#else
+            const ssize_t sent = ::send(fd, p, bytes, 0);
+#endif
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            p += sent;
+            bytes -= size_t(sent);
         }
+        return true;
+    }
 
-        if (pivot == -1)
+    bool receive(void* data, size_t bytes) override
+    {
+        uint8_t* p = static_cast<uint8_t*>(data);
+        while (bytes > 0)
+        {
+            const ssize_t got = read(fd, p, bytes);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                return false;
+            p += got;
+            bytes -= size_t(got);
+        }
+        return true;
+    }
+
+    void close() override
+    {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+private:
+    int fd;
+};
+
+using Channel = std::pair<std::unique_ptr<Transport>, std::unique_ptr<Transport>>;
+
+//================================================================================
+// Function: makeSocketChannel
+// Description: Default channel factory: a connected AF_UNIX socket pair.
+//================================================================================
+Channel makeSocketChannel()
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return {};
+    return { std::unique_ptr<Transport>(new SocketTransport(fds[0])),
+             std::unique_ptr<Transport>(new SocketTransport(fds[1])) };
+}
+
+//================================================================================
+// Function: solveDistributed
+// Description: The openBox Gauss-Jordan elimination distributed over worker
+//              processes. Equation rows are dealt out block-cyclically
+//              (blockRows rows per block) and each worker builds and updates
+//              only its own rows. For every column the coordinator
+//                  - collects each worker's first unused row with a 1 there,
+//                  - fetches the chosen pivot row from its owner,
+//                  - broadcasts it; every worker eliminates the column from
+//                    its rows (owner computes) and answers with its pivot
+//                    candidate for the next column in the same round trip.
+//              Finally workers report each row's right-hand side and whether
+//              it was used as a pivot, from which the coordinator checks
+//              consistency and reads off the solution (free variables 0).
+//              Returns true if the state is solvable and no worker failed.
+//================================================================================
+bool solveDistributed(const BitVector& state, uint32_t y, uint32_t x, BitVector& ans, unsigned workers,
+                      size_t blockRows = 64, Channel (*makeChannel)() = makeSocketChannel)
+{
+    enum Command : uint64_t { Eliminate, FetchRow, Finish };
+    struct Message
+    {
+        uint64_t command, col, row;
+    };
+    const size_t boxSize = size_t(y) * x;
+    const size_t stride = wordCount(boxSize + 1);
+    const uint64_t none = UINT64_MAX;
+    workers = std::max(1u, workers);
+
+    std::vector<std::unique_ptr<Transport>> links;
+    std::vector<pid_t> children;
+    for (unsigned w = 0; w < workers; w++)
+    {
+        Channel channel = makeChannel();
+        if (!channel.first)
+            break;
+        const pid_t pid = fork();
+        if (pid < 0)
+            break;
+        if (pid > 0)
         {
+            channel.second->close();
+            links.push_back(std::move(channel.first));
+            children.push_back(pid);
             continue;
         }
 
-        if (pivot != row)
+        // Worker w: owns rows r with (r / blockRows) % workers == w
+        channel.first->close();
+        for (auto& link : links)
+            link->close();
+        Transport& link = *channel.second;
+
+        std::vector<size_t> owned;
+        for (size_t r = 0; r < boxSize; r++)
+            if ((r / blockRows) % workers == w)
+                owned.push_back(r);
+
+        BitMatrix rows(owned.size(), boxSize + 1);
+        std::vector<uint8_t> used(owned.size(), 0);
+        for (size_t k = 0; k < owned.size(); k++)
         {
-            std::swap(matrix[row], matrix[pivot]);
+            const size_t i = owned[k] / x, j = owned[k] % x;
+            for (uint32_t a = 0; a < y; a++)
+                rows.set(k, size_t(a) * x + j);
+            for (uint32_t b = 0; b < x; b++)
+                rows.set(k, i * x + b);
+            if (testBit(state, owned[k]))
+                rows.set(k, boxSize);
         }
 
-        index[col] = row;
-        // Zeroing out column col for all rows
-        for (int r = 0; r < boxSize; r++)
+        auto candidate = [&](uint64_t col) {
+            for (size_t k = 0; col < boxSize && k < owned.size(); k++)
+                if (!used[k] && rows.get(k, col))
+                    return uint64_t(owned[k]);
+            return none;
+        };
+        auto local = [&](uint64_t row) {
+            return std::lower_bound(owned.begin(), owned.end(), row) - owned.begin();
+        };
+
+        const uint64_t first = candidate(0);
+        bool alive = link.send(&first, sizeof(first));
+        BitMatrix pivot(1, boxSize + 1);
+        Message message;
+        while (alive && link.receive(&message, sizeof(message)))
         {
-            if (r != row && matrix[r][col] == 1)
+            if (message.command == FetchRow)
+            {
+                alive = link.send(rows.row(local(message.row)), stride * sizeof(uint64_t));
+            }
+            else if (message.command == Eliminate)
             {
-                for (int c = col; c <= boxSize; c++)
+                if (message.row != none)
                 {
-                    // Using XOR as subtraction 
-                    matrix[r][c] ^= matrix[row][c];
+                    if (!link.receive(pivot.row(0), stride * sizeof(uint64_t)))
+                        break;
+                    for (size_t k = 0; k < owned.size(); k++)
+                    {
+                        if (owned[k] == message.row)
+                            used[k] = 1;
+                        else if (rows.get(k, message.col))
+                            for (size_t word = message.col / 64; word < stride; word++)
+                                rows.row(k)[word] ^= pivot.row(0)[word];
+                    }
                 }
+                const uint64_t next = candidate(message.col + 1);
+                alive = link.send(&next, sizeof(next));
+            }
+            else
+            {
+                for (size_t k = 0; k < owned.size() && alive; k++)
+                {
+                    const uint64_t report[3] = { owned[k], used[k], rows.get(k, boxSize) };
+                    alive = link.send(report, sizeof(report));
+                }
+                break;
             }
         }
-        row++;
-    }
-    // Checking system consistency. If a row has no ones except for the last column, there is no solution.
-    for (int r = row; r < boxSize; r++)
-    {
-        if (matrix[r][boxSize] == 1)
-        {
-            std::cout << "No solution for SecureBox\n";
-            print(box);
-            return true;
-        }
+        _exit(alive ? 0 : 1);
     }
-    // Assigning 0 to free variables
-    std::vector<int> ans(boxSize, 0);
-    for (int col = 0; col < boxSize; col++)
+
+    auto shutdown = [&](bool result) {
+        for (auto& link : links)
+            link->close();
+        for (pid_t pid : children)
+            while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+                continue;
+        return result;
+    };
+    if (links.size() != workers)
+        return shutdown(false);
+
+    // Coordinator: one pivot per column, chosen as the lowest candidate row
+    std::vector<uint64_t> candidates(workers);
+    for (unsigned w = 0; w < workers; w++)
+        if (!links[w]->receive(&candidates[w], sizeof(uint64_t)))
+            return shutdown(false);
+
+    std::vector<uint64_t> index(boxSize, none);
+    std::vector<uint64_t> pivotRow(stride);
+    for (size_t col = 0; col < boxSize; col++)
     {
-        if (index[col] != -1)
+        const uint64_t row = *std::min_element(candidates.begin(), candidates.end());
+        if (row != none)
         {
-            ans[col] = matrix[index[col]][boxSize];
+            const Message fetch = { FetchRow, col, row };
+            Transport& owner = *links[(row / blockRows) % workers];
+            if (!owner.send(&fetch, sizeof(fetch)) || !owner.receive(pivotRow.data(), stride * sizeof(uint64_t)))
+                return shutdown(false);
+            index[col] = row;
         }
-        else
+
+        const Message eliminate = { Eliminate, col, row };
+        for (unsigned w = 0; w < workers; w++)
         {
-            ans[col] = 0;
+            if (!links[w]->send(&eliminate, sizeof(eliminate)) ||
+                (row != none && !links[w]->send(pivotRow.data(), stride * sizeof(uint64_t))))
+                return shutdown(false);
         }
+        for (unsigned w = 0; w < workers; w++)
+            if (!links[w]->receive(&candidates[w], sizeof(uint64_t)))
+                return shutdown(false);
     }
-    // Using the found matrix, correctly ordered for toggle operations.
-    for (int q = 0; q < boxSize; q++)
+
+    // Collect right-hand sides; an unused row with a 1 there is inconsistent
+    const Message finish = { Finish, 0, 0 };
+    BitVector rhs(wordCount(boxSize), 0);
+    bool solvable = true;
+    for (unsigned w = 0; w < workers; w++)
     {
-        if (ans[q] == 1)
+        if (!links[w]->send(&finish, sizeof(finish)))
+            return shutdown(false);
+        const size_t rowsOwned = [&] {
+            size_t c = 0;
+            for (size_t r = 0; r < boxSize; r++)
+                c += (r / blockRows) % workers == w;
+            return c;
+        }();
+        for (size_t k = 0; k < rowsOwned; k++)
         {
-            uint32_t a = q / x;
-            uint32_t b = q % x;
-            box.toggle(a, b);
+            uint64_t report[3];
+            if (!links[w]->receive(report, sizeof(report)))
+                return shutdown(false);
+            if (report[2])
+                flipBit(rhs, report[0]);
+            if (!report[1] && report[2])
+                solvable = false;
         }
     }
 
+    ans.assign(wordCount(boxSize), 0);
+    for (size_t col = 0; col < boxSize; col++)
+        if (index[col] != none && testBit(rhs, index[col]))
+            flipBit(ans, col);
+    return shutdown(solvable);
+}
+#endif
+
+//================================================================================
+// Function: solveToTarget
+// Description: Finds toggles that take the current state to the target state
+//              in one pass: toggling is linear, so this is the all-false solve
+//              of current XOR target.
+//              Returns true if the target is reachable.
+//================================================================================
+bool solveToTarget(const BitVector& current, const BitVector& target, uint32_t y, uint32_t x, BitVector& ans)
+{
+    BitVector diff(wordCount(size_t(y) * x), 0);
+    for (size_t w = 0; w < diff.size(); w++)
+        diff[w] = (w < current.size() ? current[w] : 0) ^ (w < target.size() ? target[w] : 0);
+    return solveState(diff, y, x, ans);
+}
+
+//================================================================================
+// Function: driveBox
+// Description: Moves the box to the target state (e.g. a maintenance
+//              pattern) without unlocking it first.
+//              Returns true if the box ends up in the target state.
+//================================================================================
+bool driveBox(SecureBox& box, uint32_t y, uint32_t x, const BitVector& target)
+{
+    BitVector ans;
+    if (!solveToTarget(packState(box.getState(), y, x), target, y, x, ans))
+        return false;
+    applyToggles(box, ans, x);
+    return packState(box.getState(), y, x) == target;
+}
+
+//================================================================================
+// Function: solveForbidden
+// Description: Solves with some toggle positions forbidden (their variables
+//              fixed to 0), correcting the cached solve map instead of
+//              eliminating a reduced system for every damage pattern.
+//              Every solution is s0 + K^T z, with s0 from the solve map and K
+//              its kernel basis, so the forbidden cells F only add the small
+//              f x d system K_F z = s0_F (d = kernel dimension). That system
+//              is the whole correction; its cost depends on f and d, not on
+//              the box size. When the system is invertible (d = 0) the
+//              solution is unique and the correction is a check of s0_F.
+//              Returns true if a solution avoiding every forbidden cell exists.
+//================================================================================
+bool solveForbidden(const BitVector& state, uint32_t y, uint32_t x, const std::vector<Cell>& forbidden,
+                    BitVector& ans)
+{
+    const SolveMap& map = cachedSolveMap(y, x);
+    const BitVector syndrome = map.checks.multiply(state);
+    if (std::any_of(syndrome.begin(), syndrome.end(), [](uint64_t w) { return w != 0; }))
+        return false;
+    ans = map.solution.multiply(state);
+
+    // Rows of [K_F | s0_F], one per forbidden cell
+    const size_t d = map.kernel.rows();
+    BitMatrix correction(forbidden.size(), d + 1);
+    for (size_t r = 0; r < forbidden.size(); r++)
+    {
+        const size_t p = size_t(forbidden[r].first) * x + forbidden[r].second;
+        for (size_t k = 0; k < d; k++)
+            if (map.kernel.get(k, p))
+                correction.set(r, k);
+        if (testBit(ans, p))
+            correction.set(r, d);
+    }
+
+    size_t row = 0;
+    std::vector<int64_t> index(d, -1);
+    for (size_t col = 0; col < d && row < forbidden.size(); col++)
+    {
+        size_t pivot = row;
+        while (pivot < forbidden.size() && !correction.get(pivot, col))
+            pivot++;
+        if (pivot == forbidden.size())
+            continue;
+
+        correction.swapRows(row, pivot);
+        index[col] = int64_t(row);
+        for (size_t r = 0; r < forbidden.size(); r++)
+            if (r != row && correction.get(r, col))
+                correction.xorRow(r, row, col / 64);
+        row++;
+    }
+    for (size_t r = row; r < forbidden.size(); r++)
+        if (correction.get(r, d))
+            return false;
+
+    // Add the chosen kernel vectors to the unconstrained solution
+    for (size_t k = 0; k < d; k++)
+    {
+        if (index[k] == -1 || !correction.get(size_t(index[k]), d))
+            continue;
+        const uint64_t* v = map.kernel.row(k);
+        for (size_t w = 0; w < ans.size(); w++)
+            ans[w] ^= v[w];
+    }
+    return true;
+}
+
+//================================================================================
+// Function: solveRegion
+// Description: Partial unlock: only the cells set in mask have to end up
+//              false, the rest are don't-care. Builds one equation per masked
+//              cell (toggles stay full-grid variables) and eliminates that
+//              m x boxSize system. Free variables are 0, so the toggle set has
+//              at most m cells.
+//              Returns true if the masked cells can all be cleared.
+//================================================================================
+bool solveRegion(const BitVector& state, const BitVector& mask, uint32_t y, uint32_t x, BitVector& ans)
+{
+    const size_t boxSize = size_t(y) * x;
+
+    std::vector<size_t> cells;
+    for (size_t w = 0; w < wordCount(boxSize); w++)
+        for (uint64_t bits = mask[w]; bits; bits &= bits - 1)
+            cells.push_back(w * 64 + countTrailingZeros64(bits));
+
+    // Row e of the system: the toggles that flip masked cell e, plus its state
+    const size_t equations = cells.size();
+    BitMatrix matrix(equations, boxSize + 1);
+    for (size_t e = 0; e < equations; e++)
+    {
+        const size_t i = cells[e] / x, j = cells[e] % x;
+        for (uint32_t a = 0; a < y; a++)
+            matrix.set(e, size_t(a) * x + j);
+        for (uint32_t b = 0; b < x; b++)
+            matrix.set(e, i * x + b);
+        if (testBit(state, cells[e]))
+            matrix.set(e, boxSize);
+    }
+
+    size_t row = 0;
+    std::vector<int64_t> index(boxSize, -1);
+    for (size_t col = 0; col < boxSize && row < equations; col++)
+    {
+        size_t pivot = row;
+        while (pivot < equations && !matrix.get(pivot, col))
+            pivot++;
+        if (pivot == equations)
+            continue;
+
+        matrix.swapRows(row, pivot);
+        index[col] = int64_t(row);
+        for (size_t r = 0; r < equations; r++)
+            if (r != row && matrix.get(r, col))
+                matrix.xorRow(r, row, col / 64);
+        row++;
+    }
+    for (size_t r = row; r < equations; r++)
+        if (matrix.get(r, boxSize))
+            return false;
+
+    ans.assign(wordCount(boxSize), 0);
+    for (size_t col = 0; col < boxSize; col++)
+        if (index[col] != -1 && matrix.get(size_t(index[col]), boxSize))
+            flipBit(ans, col);
+    return true;
+}
+
+//================================================================================
+// Function: openBox
+// Description: Your task is to implement this function to unlock the SecureBox.
+//              Use only the public methods of SecureBox (toggle, getState, isLocked).
+//              You must determine the correct sequence of toggle operations to make
+//              all values in the box 'false'. The function should return false if
+//              the box is successfully unlocked, or true if any cell remains locked.
+//================================================================================
+
+bool openBox(uint32_t y, uint32_t x)
+{
+    // Construction includes SecureBox's own shuffle, which can't be traced separately
+    TraceSpan construct("construct box");
+    SecureBox box(y, x);
+    construct.close();
+
+    print(box);
+
+    // Initial matrix state from the box
+    TraceSpan pack("pack state");
+    const BitVector state = packState(box.getState(), y, x);
+    pack.close();
+
+    BitVector ans;
+    const bool solvable = solveState(state, y, x, ans);
+
+    if (!solvable)
+    {
+        std::cout << "No solution for SecureBox\n";
+        print(box);
+        return true;
+    }
+
+    // Using the found matrix, correctly ordered for toggle operations.
+    applyToggles(box, ans, x);
+
     std::cout << "Solved SecureBox: \n";
     print(box);
 
@@ -249,12 +4455,50 @@ bool openBox(uint32_t y, uint32_t x)
 
 int main(int argc, char* argv[])
 {
+    // --calibrate [path]: fit the planner's cost model to this host
+    if (argc > 1 && std::string(argv[1]) == "--calibrate")
+    {
+        const std::string path = argc > 2 ? argv[2] : kCostProfilePath;
+        const CostModel model = calibrateCostModel();
+        if (!writeCostProfile(path, model))
+        {
+            std::cout << "Cannot write " << path << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote cost profile to " << path << std::endl;
+        return 0;
+    }
+
+    // --trace path: record solver phases and write them as Chrome trace JSON
+    // --counters: report hardware counters per solver phase
+    // --latency: dump solve latency histograms
+    std::string tracePath;
+    bool latency = false;
+    for (int a = 1; a < argc; a++)
+    {
+        const std::string option = argv[a];
+        if (option == "--trace" && a + 1 < argc)
+            tracePath = argv[++a];
+        else if (option == "--counters")
+            countersEnabled.store(true);
+        else if (option == "--latency")
+            latency = true;
+    }
+    traceEnabled.store(!tracePath.empty());
+
     /*uint32_t y = std::atol(argv[1]);
     uint32_t x = std::atol(argv[2]);*/
     uint32_t y = 10;
     uint32_t x = 10;
     bool state = openBox(y, x);
 
+    if (!tracePath.empty() && !writeChromeTrace(tracePath))
+        std::cout << "Cannot write " << tracePath << std::endl;
+    if (countersEnabled.load())
+        printCounterReport(std::cout, takeCounterReport());
+    if (latency)
+        dumpLatency(std::cout);
+
     if (state)
         std::cout << "BOX: LOCKED!" << std::endl;
     else
@@ -262,4 +4506,3 @@ int main(int argc, char* argv[])
 
     return state;
 }
-